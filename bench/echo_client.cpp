@@ -0,0 +1,290 @@
+/*
+ *  A load generator for echo_server using liburingcxx.
+ *
+ *  Copyright (C) 2022 Zifeng Deng
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "latency.hpp"
+
+#include <uring/uring.hpp>
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include <bit>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+using uring = liburingcxx::uring<0>;
+
+struct options {
+    uint16_t port = 8000;
+    bool udp = false;
+    unsigned msg_size = 64;
+    unsigned seconds = 3;
+    std::vector<unsigned> conns{1, 8, 64, 256};
+};
+
+void usage(const char *prog) {
+    std::fprintf(
+        stderr,
+        "Usage: %s [options]\n"
+        "  -p <port>      port of echo_server (default 8000)\n"
+        "  -u             UDP instead of TCP\n"
+        "  -s <bytes>     message size (default 64)\n"
+        "  -t <sec>       runtime of each round in seconds (default 3)\n"
+        "  -c <n,n,...>   connection counts, one round each "
+        "(default 1,8,64,256)\n",
+        prog
+    );
+}
+
+bool parse_options(int argc, char *argv[], options &opt) {
+    int c;
+    while ((c = getopt(argc, argv, "p:us:t:c:h")) != -1) {
+        switch (c) {
+            case 'p': opt.port = uint16_t(std::atoi(optarg)); break;
+            case 'u': opt.udp = true; break;
+            case 's': opt.msg_size = std::atoi(optarg); break;
+            case 't': opt.seconds = std::atoi(optarg); break;
+            case 'c': {
+                opt.conns.clear();
+                for (char *p = optarg; *p != '\0';) {
+                    opt.conns.push_back(std::strtoul(p, &p, 10));
+                    if (*p == ',') {
+                        ++p;
+                    }
+                }
+                break;
+            }
+            default: return false;
+        }
+    }
+    return optind == argc && opt.msg_size != 0 && !opt.conns.empty();
+}
+
+int connect_to(const options &opt) {
+    const int fd = socket(AF_INET, opt.udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::system_error{errno, std::system_category(), "socket"};
+    }
+    if (!opt.udp) {
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        throw std::system_error{errno, std::system_category(), "connect"};
+    }
+    return fd;
+}
+
+enum class op : uint8_t { send, recv };
+
+constexpr uint64_t make_data(op o, unsigned conn) noexcept {
+    return uint64_t(o) << 32 | conn;
+}
+
+struct connection {
+    int fd;
+    unsigned sent;
+    unsigned received;
+    clock_type::time_point start;
+    std::vector<char> buf;
+};
+
+class client {
+  public:
+    client(const options &opt, unsigned conn_num)
+        : opt(opt)
+        , msg(opt.msg_size, 'x') {
+        ring.init(std::bit_ceil(conn_num * 2));
+        conns.resize(conn_num);
+        for (connection &c : conns) {
+            c.fd = connect_to(opt);
+            c.buf.resize(opt.msg_size);
+        }
+    }
+
+    ~client() noexcept {
+        for (const connection &c : conns) {
+            close(c.fd);
+        }
+    }
+
+    client(const client &) = delete;
+    client &operator=(const client &) = delete;
+
+    void run() {
+        for (unsigned i = 0; i < conns.size(); ++i) {
+            request(i);
+        }
+
+        const auto start = clock_type::now();
+        const auto deadline = start + std::chrono::seconds{opt.seconds};
+        constexpr auto give_up = std::chrono::seconds{1};
+        auto last_progress = start;
+        while (inflight != 0) {
+            ring.submit();
+            const liburingcxx::cq_entry *cqe;
+            const __kernel_timespec ts{.tv_sec = 0, .tv_nsec = 100'000'000};
+            ring.wait_cq_entries(cqe, 1, ts, nullptr);
+
+            const auto now = clock_type::now();
+            stopping = stopping || now >= deadline;
+            const unsigned n = ring.for_each_cqe(
+                [&](liburingcxx::cq_entry *cqe) { handle(*cqe, now); }
+            );
+            if (n != 0) {
+                ring.cq_advance(n);
+                last_progress = now;
+            } else if (stopping && now - last_progress > give_up) {
+                // some UDP datagrams are lost
+                break;
+            }
+        }
+        elapsed = std::chrono::duration<double>(clock_type::now() - start)
+                      .count();
+    }
+
+    void report() {
+        std::printf(
+            "%s conns=%zu msg=%u: requests=%zu rps=%.0f\n",
+            opt.udp ? "udp" : "tcp", conns.size(), opt.msg_size,
+            latencies.size(), double(latencies.size()) / elapsed
+        );
+        bench::print_latency(latencies);
+    }
+
+  private:
+    const options &opt;
+    const std::vector<char> msg;
+    uring ring;
+    std::vector<connection> conns;
+    std::vector<uint64_t> latencies;
+    unsigned inflight = 0;
+    bool stopping = false;
+    double elapsed = 0;
+
+    liburingcxx::sq_entry &get_sqe() {
+        liburingcxx::sq_entry *sqe = ring.get_sq_entry();
+        if (sqe == nullptr) [[unlikely]] {
+            ring.submit();
+            sqe = ring.get_sq_entry();
+        }
+        return *sqe;
+    }
+
+    void request(unsigned i) {
+        connection &c = conns[i];
+        c.sent = 0;
+        c.received = 0;
+        c.start = clock_type::now();
+        send(i);
+        recv(i);
+        ++inflight;
+    }
+
+    void send(unsigned i) {
+        connection &c = conns[i];
+        get_sqe()
+            .prep_send(c.fd, std::span{msg}.subspan(c.sent), MSG_NOSIGNAL)
+            .set_data(make_data(op::send, i));
+    }
+
+    void recv(unsigned i) {
+        connection &c = conns[i];
+        get_sqe()
+            .prep_recv(c.fd, std::span{c.buf}.subspan(c.received), 0)
+            .set_data(make_data(op::recv, i));
+    }
+
+    void handle(const liburingcxx::cq_entry &cqe, clock_type::time_point now) {
+        const auto i = unsigned(cqe.user_data);
+        if (cqe.res < 0) [[unlikely]] {
+            throw std::system_error{
+                -cqe.res, std::system_category(),
+                op(cqe.user_data >> 32) == op::send ? "send" : "recv"
+            };
+        }
+        connection &c = conns[i];
+        if (op(cqe.user_data >> 32) == op::send) {
+            // TCP may send a part of the message, send the rest
+            c.sent += unsigned(cqe.res);
+            if (c.sent < opt.msg_size) [[unlikely]] {
+                send(i);
+            }
+            return;
+        }
+
+        if (cqe.res == 0) [[unlikely]] {
+            // EOF, the server closed the connection mid-request
+            throw std::system_error{
+                ECONNRESET, std::system_category(), "recv"
+            };
+        }
+
+        c.received += unsigned(cqe.res);
+        if (c.received < opt.msg_size) {
+            recv(i);
+            return;
+        }
+
+        latencies.push_back(std::chrono::nanoseconds{now - c.start}.count());
+        --inflight;
+        if (!stopping) {
+            request(i);
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    options opt;
+    if (!parse_options(argc, argv, opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        for (const unsigned n : opt.conns) {
+            client c{opt, n};
+            c.run();
+            c.report();
+        }
+    } catch (const std::system_error &e) {
+        std::cerr << e.what() << "\n" << e.code() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,471 @@
+/*
+ *  A loopback echo server using liburingcxx.
+ *
+ *  Copyright (C) 2022 Zifeng Deng
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <uring/uring.hpp>
+
+#include <iostream>
+
+#if !LIBURINGCXX_IS_KERNEL_REACH(6, 0)
+int main() {
+    std::cerr << "echo_server requires Linux 6.0 or newer.\n";
+    return 1;
+}
+#else
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct options {
+    uint16_t port = 8000;
+    bool udp = false;
+    bool fixed_files = false;
+    bool send_zc = false;
+    bool defer_taskrun = false;
+    unsigned buf_size = 4096;
+    unsigned buf_count = 1024;
+    unsigned max_conns = 4096;
+};
+
+void usage(const char *prog) {
+    std::fprintf(
+        stderr,
+        "Usage: %s [options]\n"
+        "  -p <port>    port to listen on (default 8000)\n"
+        "  -u           UDP instead of TCP\n"
+        "  -f           fixed files, and multishot accept into them\n"
+        "  -z           SEND_ZC instead of SEND\n"
+        "  -d           SINGLE_ISSUER | DEFER_TASKRUN, since Linux 6.1\n"
+        "  -b <bytes>   size of each provided buffer (default 4096)\n"
+        "  -n <num>     number of provided buffers, pow of 2 (default 1024)\n"
+        "  -c <num>     max TCP connections with -f (default 4096)\n",
+        prog
+    );
+}
+
+bool parse_options(int argc, char *argv[], options &opt) {
+    int c;
+    while ((c = getopt(argc, argv, "p:ufzdb:n:c:h")) != -1) {
+        switch (c) {
+            case 'p': opt.port = uint16_t(std::atoi(optarg)); break;
+            case 'u': opt.udp = true; break;
+            case 'f': opt.fixed_files = true; break;
+            case 'z': opt.send_zc = true; break;
+            case 'd': opt.defer_taskrun = true; break;
+            case 'b': opt.buf_size = std::atoi(optarg); break;
+            case 'n': opt.buf_count = std::atoi(optarg); break;
+            case 'c': opt.max_conns = std::atoi(optarg); break;
+            default: return false;
+        }
+    }
+    return optind == argc && opt.buf_count != 0
+           && (opt.buf_count & (opt.buf_count - 1)) == 0
+           && opt.buf_count <= 32768;
+}
+
+int setup_socket(const options &opt) {
+    const int fd = socket(AF_INET, opt.udp ? SOCK_DGRAM : SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::system_error{errno, std::system_category(), "socket"};
+    }
+    const int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        throw std::system_error{errno, std::system_category(), "bind"};
+    }
+    if (!opt.udp && listen(fd, 1024) < 0) {
+        throw std::system_error{errno, std::system_category(), "listen"};
+    }
+    return fd;
+}
+
+enum class op : uint8_t { accept, recv, send, close, shutdown };
+
+/*
+ * user_data layout:
+ * [63]     fire_and_forget_flag, only set by closing and shutdown
+ * [62, 56] op
+ * [47, 32] buffer id
+ * [31,  0] fd, or fixed file index
+ */
+constexpr uint64_t make_data(op o, uint16_t bid, int fd) noexcept {
+    return uint64_t(o) << 56 | uint64_t(bid) << 32 | uint32_t(fd);
+}
+
+constexpr op data_op(uint64_t data) noexcept {
+    return op(data >> 56);
+}
+
+constexpr uint16_t data_bid(uint64_t data) noexcept {
+    return uint16_t(data >> 32);
+}
+
+constexpr int data_fd(uint64_t data) noexcept {
+    return int(uint32_t(data));
+}
+
+template<uint64_t uring_flags>
+class server {
+  public:
+    server(const options &opt, int listen_fd)
+        : opt(opt)
+        , listen_fd(listen_fd)
+        , buffers(new char[size_t(opt.buf_size) * opt.buf_count]) {
+        ring.init(4096);
+
+        if (opt.fixed_files) {
+            // UDP uses slot 0 for the socket, TCP accepts into all slots
+            std::vector<int> fds(opt.udp ? 1 : opt.max_conns, -1);
+            if (opt.udp) {
+                fds[0] = listen_fd;
+            }
+            ring.register_files(fds);
+        }
+
+        br = &ring.setup_buf_ring(opt.buf_count, buf_group);
+        for (unsigned bid = 0; bid < opt.buf_count; ++bid) {
+            br->add(
+                buffer_of(bid), opt.buf_size, bid,
+                liburingcxx::buf_ring::mask_of(opt.buf_count), int(bid)
+            );
+        }
+        br->advance(int(opt.buf_count));
+
+        if (opt.udp) {
+            replies.resize(opt.buf_count);
+            recv_msg.msg_namelen = sizeof(sockaddr_storage);
+        } else {
+            send_lens.resize(opt.buf_count);
+        }
+    }
+
+    ~server() noexcept {
+        ring.free_buf_ring(*br, opt.buf_count, buf_group);
+    }
+
+    server(const server &) = delete;
+    server &operator=(const server &) = delete;
+
+    [[noreturn]] void run() {
+        if (opt.udp) {
+            arm_recvmsg();
+        } else {
+            arm_accept();
+        }
+
+        while (true) {
+            ring.submit_and_wait(1);
+            const unsigned n = ring.for_each_cqe(
+                [this](liburingcxx::cq_entry *cqe) { handle(*cqe); },
+                [](liburingcxx::cq_entry *cqe) {
+                    const uint64_t data =
+                        cqe->user_data & ~liburingcxx::fire_and_forget_flag;
+                    std::fprintf(
+                        stderr, "%s %d: %s\n",
+                        data_op(data) == op::close ? "close" : "shutdown",
+                        data_fd(data), std::strerror(-cqe->res)
+                    );
+                }
+            );
+            if (n != 0) {
+                ring.cq_advance(n);
+            }
+        }
+    }
+
+  private:
+    static constexpr uint16_t buf_group = 0;
+
+    // reply of a UDP datagram, indexed by the buffer id holding it
+    struct udp_reply {
+        msghdr msg;
+        iovec iov;
+        sockaddr_storage addr;
+    };
+
+    const options &opt;
+    const int listen_fd;
+    liburingcxx::uring<uring_flags> ring;
+    liburingcxx::buf_ring *br;
+    std::unique_ptr<char[]> buffers;
+    std::vector<udp_reply> replies;
+    // length of the TCP send in flight, indexed by the buffer id holding it
+    std::vector<unsigned> send_lens;
+    msghdr recv_msg{};
+
+    char *buffer_of(unsigned bid) noexcept {
+        return buffers.get() + size_t(bid) * opt.buf_size;
+    }
+
+    liburingcxx::sq_entry &get_sqe() {
+        liburingcxx::sq_entry *sqe = ring.get_sq_entry();
+        if (sqe == nullptr) [[unlikely]] {
+            ring.submit();
+            sqe = ring.get_sq_entry();
+        }
+        return *sqe;
+    }
+
+    liburingcxx::sq_entry &set_file(liburingcxx::sq_entry &sqe) noexcept {
+        return opt.fixed_files ? sqe.set_fixed_file() : sqe;
+    }
+
+    void recycle(uint16_t bid) noexcept {
+        br->add(
+            buffer_of(bid), opt.buf_size, bid,
+            liburingcxx::buf_ring::mask_of(opt.buf_count), 0
+        );
+        br->advance(1);
+    }
+
+    void arm_accept() {
+        auto &sqe = get_sqe();
+        if (opt.fixed_files) {
+            sqe.prep_multishot_accept_direct(listen_fd, nullptr, nullptr, 0);
+        } else {
+            sqe.prep_multishot_accept(listen_fd, nullptr, nullptr, 0);
+        }
+        sqe.set_data(make_data(op::accept, 0, listen_fd));
+    }
+
+    void arm_recv(int fd) {
+        auto &sqe = get_sqe();
+        sqe.prep_recv_multishot(fd, {}, 0).set_buffer_select(buf_group);
+        set_file(sqe).set_data(make_data(op::recv, 0, fd));
+    }
+
+    void arm_recvmsg() {
+        const int fd = opt.fixed_files ? 0 : listen_fd;
+        auto &sqe = get_sqe();
+        sqe.prep_recvmsg_multishot(fd, &recv_msg, 0)
+            .set_buffer_select(buf_group);
+        set_file(sqe).set_data(make_data(op::recv, 0, fd));
+    }
+
+    void close_conn(int fd) {
+        auto &sqe = get_sqe();
+        if (opt.fixed_files) {
+            sqe.prep_close_direct(fd);
+        } else {
+            sqe.prep_close(fd);
+        }
+        // nothing to do on success, so only a failure posts a CQE
+        sqe.set_fire_and_forget(make_data(op::close, 0, fd));
+    }
+
+    // the multishot recv then ends, and closes the connection
+    void shutdown_conn(int fd) {
+        auto &sqe = get_sqe();
+        set_file(sqe.prep_shutdown(fd, SHUT_RDWR))
+            .set_fire_and_forget(make_data(op::shutdown, 0, fd));
+    }
+
+    void send(int fd, std::span<const char> buf, uint16_t bid) {
+        // the kernel retries short sends, so a short result means failure
+        constexpr int flags = MSG_NOSIGNAL | MSG_WAITALL;
+        send_lens[bid] = unsigned(buf.size());
+        auto &sqe = get_sqe();
+        if (opt.send_zc) {
+            sqe.prep_send_zc(fd, buf, flags, 0);
+        } else {
+            sqe.prep_send(fd, buf, flags);
+        }
+        set_file(sqe).set_data(make_data(op::send, bid, fd));
+    }
+
+    void sendmsg(int fd, const msghdr &msg, uint16_t bid) {
+        auto &sqe = get_sqe();
+        if (opt.send_zc) {
+            sqe.prep_sendmsg_zc(fd, &msg, 0);
+        } else {
+            sqe.prep_sendmsg(fd, &msg, 0);
+        }
+        set_file(sqe).set_data(make_data(op::send, bid, fd));
+    }
+
+    void handle(const liburingcxx::cq_entry &cqe) {
+        const uint64_t data = cqe.user_data;
+        switch (data_op(data)) {
+            case op::accept: on_accept(cqe); break;
+            case op::recv:
+                if (opt.udp) {
+                    on_recvmsg(cqe);
+                } else {
+                    on_recv(cqe);
+                }
+                break;
+            case op::send: on_send(cqe); break;
+            // fire-and-forget, see run()
+            case op::close:
+            case op::shutdown: break;
+        }
+    }
+
+    void on_accept(const liburingcxx::cq_entry &cqe) {
+        if (cqe.res >= 0) {
+            arm_recv(cqe.res);
+        }
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            arm_accept();
+        }
+    }
+
+    void on_recv(const liburingcxx::cq_entry &cqe) {
+        const int fd = data_fd(cqe.user_data);
+        const bool has_buffer = cqe.flags & IORING_CQE_F_BUFFER;
+        const auto bid = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+        if (cqe.res > 0 && has_buffer) {
+            send(fd, {buffer_of(bid), size_t(cqe.res)}, bid);
+        } else if (has_buffer) {
+            recycle(bid);
+        }
+
+        if (cqe.flags & IORING_CQE_F_MORE) {
+            return;
+        }
+        // out of provided buffers, try again
+        if (cqe.res > 0 || cqe.res == -ENOBUFS) {
+            arm_recv(fd);
+        } else {
+            close_conn(fd);
+        }
+    }
+
+    void on_recvmsg(const liburingcxx::cq_entry &cqe) {
+        const int fd = data_fd(cqe.user_data);
+        const bool has_buffer = cqe.flags & IORING_CQE_F_BUFFER;
+        const auto bid = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+        if (cqe.res > 0 && has_buffer) {
+            io_uring_recvmsg_out *const out = liburingcxx::recvmsg_validate(
+                {buffer_of(bid), size_t(cqe.res)}, &recv_msg
+            );
+            if (out != nullptr && out->namelen <= sizeof(sockaddr_storage)) {
+                udp_reply &reply = replies[bid];
+                std::memcpy(
+                    &reply.addr, liburingcxx::recvmsg_name(out), out->namelen
+                );
+                reply.iov.iov_base =
+                    liburingcxx::recvmsg_payload(out, &recv_msg);
+                reply.iov.iov_len = liburingcxx::recvmsg_payload_length(
+                    out, cqe.res, &recv_msg
+                );
+                reply.msg = {};
+                reply.msg.msg_name = &reply.addr;
+                reply.msg.msg_namelen = out->namelen;
+                reply.msg.msg_iov = &reply.iov;
+                reply.msg.msg_iovlen = 1;
+                sendmsg(fd, reply.msg, bid);
+            } else {
+                recycle(bid);
+            }
+        } else if (has_buffer) {
+            recycle(bid);
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            arm_recvmsg();
+        }
+    }
+
+    void on_send(const liburingcxx::cq_entry &cqe) {
+        const int fd = data_fd(cqe.user_data);
+        const uint16_t bid = data_bid(cqe.user_data);
+        const bool failed =
+            cqe.res < 0 || (!opt.udp && unsigned(cqe.res) != send_lens[bid]);
+        if (!(cqe.flags & IORING_CQE_F_NOTIF) && failed) [[unlikely]] {
+            std::fprintf(
+                stderr, "send %d: %s\n", fd,
+                cqe.res < 0 ? std::strerror(-cqe.res) : "short send"
+            );
+            // a TCP echo can not go on with bytes missing
+            if (!opt.udp) {
+                shutdown_conn(fd);
+            }
+        }
+
+        /*
+         * A zero-copy send posts a second CQE with IORING_CQE_F_NOTIF when
+         * the buffer is released by the network stack, and sets
+         * IORING_CQE_F_MORE on the first one if that is going to happen.
+         */
+        if ((cqe.flags & IORING_CQE_F_NOTIF)
+            || !(cqe.flags & IORING_CQE_F_MORE)) {
+            recycle(bid);
+        }
+    }
+};
+
+template<uint64_t uring_flags>
+[[noreturn]] void run(const options &opt, int listen_fd) {
+    server<uring_flags> s{opt, listen_fd};
+    s.run();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    options opt;
+    if (!parse_options(argc, argv, opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        const int listen_fd = setup_socket(opt);
+        std::printf(
+            "echo server: %s port=%u%s%s%s\n", opt.udp ? "udp" : "tcp",
+            opt.port, opt.fixed_files ? " fixed_files" : "",
+            opt.send_zc ? " send_zc" : "",
+            opt.defer_taskrun ? " defer_taskrun" : ""
+        );
+        std::fflush(stdout);
+
+        if (opt.defer_taskrun) {
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 1)
+            constexpr uint64_t defer_taskrun =
+                IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+            run<defer_taskrun>(opt, listen_fd);
+#else
+            std::cerr << "-d requires Linux 6.1 or newer.\n";
+            return 1;
+#endif
+        } else {
+            run<0>(opt, listen_fd);
+        }
+    } catch (const std::system_error &e) {
+        std::cerr << e.what() << "\n" << e.code() << "\n";
+        return 1;
+    }
+}
+#endif
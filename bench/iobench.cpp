@@ -0,0 +1,327 @@
+/*
+ *  A fio-style file I/O benchmark using liburingcxx.
+ *
+ *  Copyright (C) 2022 Zifeng Deng
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "latency.hpp"
+
+#include <uring/uring.hpp>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct options {
+    const char *path = nullptr;
+    size_t file_size = 64UL << 20;
+    unsigned block_size = 4096;
+    unsigned depth = 32;
+    unsigned batch = 8;
+    unsigned seconds = 5;
+    uint64_t ios = 0; // 0 means limited by `seconds`
+    bool write = false;
+    bool random = false;
+    bool direct = false;
+    bool fixed_buffers = false;
+    bool fixed_files = false;
+    bool sqpoll = false;
+};
+
+struct result {
+    uint64_t ios = 0;
+    // bytes actually transferred, less than ios * block_size on short ios
+    uint64_t bytes = 0;
+    // ios completed with less than a block, e.g. reads past EOF
+    uint64_t short_ios = 0;
+    double seconds = 0;
+    std::vector<uint64_t> latencies; // in ns
+};
+
+void usage(const char *prog) {
+    std::fprintf(
+        stderr,
+        "Usage: %s [options] <file>\n"
+        "  -S <bytes>   file size, the file is extended if smaller "
+        "(default 64M)\n"
+        "  -b <bytes>   block size (default 4096)\n"
+        "  -d <num>     queue depth (default 32)\n"
+        "  -s <num>     batch submit size (default 8)\n"
+        "  -t <sec>     runtime in seconds (default 5)\n"
+        "  -n <num>     number of I/Os, overrides -t\n"
+        "  -w           write instead of read\n"
+        "  -r           random instead of sequential offsets\n"
+        "  -D           O_DIRECT\n"
+        "  -B           fixed (registered) buffers\n"
+        "  -F           fixed (registered) file\n"
+        "  -P           SQPOLL\n",
+        prog
+    );
+}
+
+size_t parse_size(const char *s) {
+    char *end;
+    size_t n = std::strtoull(s, &end, 10);
+    switch (*end) {
+        case 'g':
+        case 'G': n <<= 10; [[fallthrough]];
+        case 'm':
+        case 'M': n <<= 10; [[fallthrough]];
+        case 'k':
+        case 'K': n <<= 10; break;
+        default: break;
+    }
+    return n;
+}
+
+bool parse_options(int argc, char *argv[], options &opt) {
+    int c;
+    while ((c = getopt(argc, argv, "S:b:d:s:t:n:wrDBFPh")) != -1) {
+        switch (c) {
+            case 'S': opt.file_size = parse_size(optarg); break;
+            case 'b': opt.block_size = parse_size(optarg); break;
+            case 'd': opt.depth = std::atoi(optarg); break;
+            case 's': opt.batch = std::atoi(optarg); break;
+            case 't': opt.seconds = std::atoi(optarg); break;
+            case 'n': opt.ios = std::strtoull(optarg, nullptr, 10); break;
+            case 'w': opt.write = true; break;
+            case 'r': opt.random = true; break;
+            case 'D': opt.direct = true; break;
+            case 'B': opt.fixed_buffers = true; break;
+            case 'F': opt.fixed_files = true; break;
+            case 'P': opt.sqpoll = true; break;
+            default: return false;
+        }
+    }
+    if (optind + 1 != argc || opt.block_size == 0 || opt.depth == 0
+        || opt.batch == 0 || opt.file_size < opt.block_size) {
+        return false;
+    }
+    opt.path = argv[optind];
+    opt.batch = std::min(opt.batch, opt.depth);
+    return true;
+}
+
+int open_file(const options &opt) {
+    // O_RDWR even for reads, since the file may need to be extended
+    const int flags = O_RDWR | O_CREAT | (opt.direct ? O_DIRECT : 0);
+    const int fd = open(opt.path, flags, 0644);
+    if (fd < 0) {
+        throw std::system_error{errno, std::system_category(), "open"};
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        throw std::system_error{errno, std::system_category(), "fstat"};
+    }
+    if (S_ISREG(st.st_mode) && size_t(st.st_size) < opt.file_size) {
+        if (ftruncate(fd, off_t(opt.file_size)) < 0) {
+            throw std::system_error{
+                errno, std::system_category(), "ftruncate"
+            };
+        }
+    }
+    return fd;
+}
+
+template<uint64_t uring_flags>
+result run(const options &opt, int fd) {
+    using uring = liburingcxx::uring<uring_flags>;
+    constexpr bool is_sqpoll = uring_flags & IORING_SETUP_SQPOLL;
+
+    uring ring;
+    ring.init(std::bit_ceil(opt.depth));
+
+    // one block per in-flight slot
+    const size_t bs = opt.block_size;
+    const size_t buffer_size = (bs * opt.depth + 4095) & ~4095UL;
+    std::unique_ptr<char, decltype(&std::free)> buffer{
+        static_cast<char *>(std::aligned_alloc(4096, buffer_size)), &std::free
+    };
+    std::memset(buffer.get(), 0xAA, bs * opt.depth);
+
+    if (opt.fixed_buffers) {
+        std::vector<iovec> iovecs(opt.depth);
+        for (unsigned i = 0; i < opt.depth; ++i) {
+            iovecs[i] = {buffer.get() + i * bs, bs};
+        }
+        ring.register_buffers(iovecs);
+    }
+    const int file = opt.fixed_files ? 0 : fd;
+    if (opt.fixed_files) {
+        ring.register_files({&fd, 1});
+    }
+
+    const uint64_t blocks = opt.file_size / bs;
+    std::mt19937_64 rng{std::random_device{}()};
+    uint64_t next_block = 0;
+
+    std::vector<clock_type::time_point> issued(opt.depth);
+    std::vector<unsigned> free_slots(opt.depth);
+    std::iota(free_slots.begin(), free_slots.end(), 0U);
+
+    result res;
+    res.latencies.reserve(opt.ios ? opt.ios : 1U << 20);
+
+    const auto start = clock_type::now();
+    const auto deadline = start + std::chrono::seconds{opt.seconds};
+    uint64_t submitted = 0;
+    unsigned inflight = 0;
+    bool stopping = false;
+
+    while (!stopping || inflight != 0) {
+        unsigned prepared = 0;
+        while (!stopping && prepared < opt.batch && !free_slots.empty()) {
+            const unsigned slot = free_slots.back();
+            free_slots.pop_back();
+
+            const uint64_t block = opt.random ? rng() % blocks
+                                              : next_block++ % blocks;
+            const uint64_t offset = block * bs;
+            char *const buf = buffer.get() + slot * bs;
+
+            liburingcxx::sq_entry &sqe = *ring.get_sq_entry();
+            if (opt.fixed_buffers) {
+                if (opt.write) {
+                    sqe.prep_write_fixed(file, {buf, bs}, offset, slot);
+                } else {
+                    sqe.prep_read_fixed(file, {buf, bs}, offset, slot);
+                }
+            } else {
+                if (opt.write) {
+                    sqe.prep_write(file, {buf, bs}, offset);
+                } else {
+                    sqe.prep_read(file, {buf, bs}, offset);
+                }
+            }
+            if (opt.fixed_files) {
+                sqe.set_fixed_file();
+            }
+            sqe.set_data(slot);
+
+            issued[slot] = clock_type::now();
+            ++prepared;
+            ++submitted;
+            if (opt.ios != 0 && submitted == opt.ios) {
+                stopping = true;
+            }
+        }
+        inflight += prepared;
+
+        if constexpr (is_sqpoll) {
+            ring.submit();
+            if (ring.cq_ready_acquire() == 0) {
+                const liburingcxx::cq_entry *cqe;
+                ring.wait_cq_entry(cqe);
+            }
+        } else {
+            ring.submit_and_wait(1);
+        }
+
+        const auto now = clock_type::now();
+        const unsigned reaped =
+            ring.for_each_cqe([&](liburingcxx::cq_entry *cqe) {
+                if (cqe->res < 0) [[unlikely]] {
+                    throw std::system_error{
+                        -cqe->res, std::system_category(),
+                        opt.write ? "write" : "read"
+                    };
+                }
+                res.bytes += unsigned(cqe->res);
+                if (unsigned(cqe->res) < bs) [[unlikely]] {
+                    ++res.short_ios;
+                }
+                const auto slot = static_cast<unsigned>(cqe->user_data);
+                res.latencies.push_back(
+                    std::chrono::nanoseconds{now - issued[slot]}.count()
+                );
+                free_slots.push_back(slot);
+            });
+        if (reaped != 0) {
+            ring.cq_advance(reaped);
+            inflight -= reaped;
+            res.ios += reaped;
+        }
+
+        if (opt.ios == 0 && !stopping && now >= deadline) {
+            stopping = true;
+        }
+    }
+
+    res.seconds =
+        std::chrono::duration<double>(clock_type::now() - start).count();
+    return res;
+}
+
+void report(const options &opt, result &res) {
+    const double iops = double(res.ios) / res.seconds;
+    std::printf(
+        "%s %s: bs=%u depth=%u batch=%u%s%s%s%s\n",
+        opt.random ? "rand" : "seq", opt.write ? "write" : "read",
+        opt.block_size, opt.depth, opt.batch, opt.direct ? " direct" : "",
+        opt.fixed_buffers ? " fixed_buffers" : "",
+        opt.fixed_files ? " fixed_files" : "", opt.sqpoll ? " sqpoll" : ""
+    );
+    std::printf(
+        "  ios=%" PRIu64 " runtime=%.3fs iops=%.0f bw=%.2fMiB/s\n", res.ios,
+        res.seconds, iops, double(res.bytes) / res.seconds / (1 << 20)
+    );
+    if (res.short_ios != 0) {
+        std::printf("  short ios=%" PRIu64 "\n", res.short_ios);
+    }
+    bench::print_latency(res.latencies);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    options opt;
+    if (!parse_options(argc, argv, opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        const int fd = open_file(opt);
+        result res = opt.sqpoll ? run<IORING_SETUP_SQPOLL>(opt, fd)
+                                : run<0>(opt, fd);
+        close(fd);
+        report(opt, res);
+    } catch (const std::system_error &e) {
+        std::cerr << e.what() << "\n" << e.code() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
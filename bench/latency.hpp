@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace bench {
+
+/**
+ * @brief Sort the latencies (in ns) and print mean and percentiles in us.
+ */
+inline void print_latency(std::vector<uint64_t> &latencies) {
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&](double p) -> double {
+        if (latencies.empty()) {
+            return 0;
+        }
+        const size_t i = std::min<size_t>(
+            latencies.size() - 1, size_t(p / 100 * double(latencies.size()))
+        );
+        return double(latencies[i]) / 1000;
+    };
+    double mean = 0;
+    for (const uint64_t lat : latencies) {
+        mean += double(lat);
+    }
+    mean = latencies.empty() ? 0 : mean / double(latencies.size()) / 1000;
+
+    std::printf(
+        "  lat(us): mean=%.2f p50=%.2f p90=%.2f p99=%.2f p99.9=%.2f "
+        "p99.99=%.2f max=%.2f\n",
+        mean, percentile(50), percentile(90), percentile(99),
+        percentile(99.9), percentile(99.99), percentile(100)
+    );
+}
+
+} // namespace bench
@@ -0,0 +1,463 @@
+/*
+ *  Micro benchmarks of liburingcxx, side by side with axboe/liburing.
+ *
+ *  Copyright (C) 2022 Zifeng Deng
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <uring/uring.hpp>
+#include <uring/utility/ring_simulator.hpp>
+
+#if LIBURINGCXX_BENCH_WITH_LIBURING
+#include <liburing.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <atomic>
+#include <thread>
+
+namespace {
+
+using liburingcxx::uring;
+using liburingcxx::uring_setup;
+
+constexpr unsigned ring_entries = 256;
+
+constexpr uint64_t flags_default = 0;
+constexpr uint64_t flags_reorder = uring_setup::sqe_reorder;
+constexpr uint64_t flags_sqpoll = IORING_SETUP_SQPOLL;
+constexpr uint64_t flags_sqpoll_reorder =
+    IORING_SETUP_SQPOLL | uring_setup::sqe_reorder;
+constexpr uint64_t flags_sqpoll_separated =
+    IORING_SETUP_SQPOLL | uring_setup::cacheline_separated;
+constexpr uint64_t flags_sqpoll_sqe128 =
+    IORING_SETUP_SQPOLL | IORING_SETUP_SQE128;
+
+/*******************************
+ *    liburingcxx benchmarks    *
+ *******************************
+ */
+
+template<uint64_t uring_flags>
+void get_nop(uring<uring_flags> &ring) noexcept {
+    liburingcxx::sq_entry *const sqe = ring.get_sq_entry();
+    sqe->prep_nop().set_data(0);
+    if constexpr (uring_flags & uring_setup::sqe_reorder) {
+        ring.append_sq_entry(sqe);
+    }
+}
+
+template<uint64_t uring_flags>
+void reap(uring<uring_flags> &ring, unsigned num) {
+    unsigned reaped = 0;
+    while (reaped < num) {
+        const unsigned n = ring.for_each_cqe([](liburingcxx::cq_entry *cqe) {
+            benchmark::DoNotOptimize(cqe->res);
+        });
+        if (n == 0) {
+            if constexpr (uring_flags & IORING_SETUP_SQPOLL) {
+                // give way to the kernel thread if they share a CPU
+                std::this_thread::yield();
+                continue;
+            } else {
+                const liburingcxx::cq_entry *cqe;
+                ring.wait_cq_entry(cqe);
+                continue;
+            }
+        }
+        ring.cq_advance(n);
+        reaped += n;
+    }
+}
+
+// NOP submit and reap, `state.range(0)` NOPs per io_uring_enter
+template<uint64_t uring_flags>
+void BM_nop_cxx(benchmark::State &state) {
+    const auto batch = static_cast<unsigned>(state.range(0));
+    uring<uring_flags> ring;
+    ring.init(ring_entries);
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < batch; ++i) {
+            get_nop(ring);
+        }
+        if constexpr (uring_flags & IORING_SETUP_SQPOLL) {
+            ring.submit();
+        } else {
+            ring.submit_and_wait(batch);
+        }
+        reap(ring, batch);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch);
+}
+
+/*
+ * Fill a full SQ of NOPs by get_sq_entry, then submit and reap them. Pausing
+ * the timer around the submission would cost more than the filling itself,
+ * so the round trip is timed as well and amortized over the whole SQ.
+ */
+template<uint64_t uring_flags>
+void BM_get_sq_entry_cxx(benchmark::State &state) {
+    uring<uring_flags> ring;
+    ring.init(ring_entries);
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < ring_entries; ++i) {
+            get_nop(ring);
+        }
+        ring.submit_and_wait(ring_entries);
+        reap(ring, ring_entries);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * ring_entries);
+}
+
+/*
+ * Fill a full SQ of read sqes by `fill(sqe, i)` on a simulated ring, then
+ * submit and reap them without a syscall. The round trip costs the same for
+ * every way of filling, so they can be compared, while pausing the timer
+ * around a real submission would cost more than the filling itself.
+ */
+template<uint64_t uring_flags, typename F>
+void fill_reads(benchmark::State &state, F fill) {
+    uring<uring_flags> ring;
+    liburingcxx::ring_simulator<uring_flags> sim{ring, ring_entries};
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < ring_entries; ++i) {
+            fill(*ring.get_sq_entry(), i);
+        }
+        ring.submit();
+        reap(ring, ring_entries);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * ring_entries);
+}
+
+// cost of filling read sqes by `prep_read`
+void BM_prep_read_cxx(benchmark::State &state) {
+    static char buf[4096];
+    fill_reads<flags_sqpoll>(state, [](liburingcxx::sq_entry &sqe, unsigned i) {
+        sqe.prep_read(-1, buf, uint64_t(i) * sizeof(buf)).set_data(i);
+    });
+}
+
+// same as BM_prep_read_cxx, but writing whole words by `fill_rw`
+void BM_fill_read_cxx(benchmark::State &state) {
+    static char buf[4096];
+    fill_reads<flags_sqpoll>(state, [](liburingcxx::sq_entry &sqe, unsigned i) {
+        sqe.fill_rw(
+            IORING_OP_READ, -1, buf, sizeof(buf), uint64_t(i) * sizeof(buf), i
+        );
+    });
+}
+
+// same as BM_prep_read_cxx, but stamping a precomputed `sqe_template`
+template<uint64_t uring_flags>
+void BM_stamp_read_cxx(benchmark::State &state) {
+    static char buf[4096];
+    liburingcxx::sqe_template<uring_flags> tpl;
+    tpl.image().prep_read(-1, buf, 0);
+    fill_reads<uring_flags>(
+        state,
+        [&tpl](liburingcxx::sq_entry &sqe, unsigned i) {
+            tpl.stamp(sqe, buf, sizeof(buf), uint64_t(i) * sizeof(buf), i);
+        }
+    );
+}
+
+// NOP round trip reaped by peek_batch_cq_entries, see BM_get_sq_entry_cxx
+void BM_peek_batch_cxx(benchmark::State &state) {
+    const auto batch = static_cast<unsigned>(state.range(0));
+    uring<flags_default> ring;
+    ring.init(ring_entries);
+    std::array<const liburingcxx::cq_entry *, ring_entries> cqes;
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < batch; ++i) {
+            get_nop(ring);
+        }
+        ring.submit_and_wait(batch);
+
+        unsigned reaped = 0;
+        while (reaped < batch) {
+            const unsigned n = ring.peek_batch_cq_entries(cqes);
+            benchmark::DoNotOptimize(cqes.data());
+            ring.cq_advance(n);
+            reaped += n;
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch);
+}
+
+// io_uring_enter(GETEVENTS) through the registered ring fd
+void BM_enter_registered_cxx(benchmark::State &state) {
+    uring<flags_default> ring;
+    ring.init(ring_entries);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(ring.get_events());
+    }
+}
+
+// io_uring_enter(GETEVENTS) through the normal ring fd
+void BM_enter_plain_cxx(benchmark::State &state) {
+    uring<flags_default> ring;
+    ring.init(ring_entries);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(__sys_io_uring_enter(
+            ring.fd(), 0, 0, IORING_ENTER_GETEVENTS, nullptr
+        ));
+    }
+}
+
+/*
+ * Userspace cost of a NOP round trip on a simulated ring: get_sq_entry,
+ * flush and for_each_cqe, without kernel work.
+ */
+template<uint64_t uring_flags>
+void BM_sim_nop_cxx(benchmark::State &state) {
+    const auto batch = static_cast<unsigned>(state.range(0));
+    uring<uring_flags> ring;
+    liburingcxx::ring_simulator<uring_flags> sim{ring, ring_entries};
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < batch; ++i) {
+            get_nop(ring);
+        }
+        ring.submit();
+        reap(ring, batch);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch);
+}
+
+/*
+ * The reaper-thread model on a simulated ring: this thread submits NOPs while
+ * another thread polls the CQ by peek_batch_cq_entries. With
+ * `cacheline_separated`, polling does not read the cache line written by
+ * get_sq_entry.
+ */
+template<uint64_t uring_flags>
+void BM_sim_reaper_cxx(benchmark::State &state) {
+    const auto batch = static_cast<unsigned>(state.range(0));
+    uring<uring_flags> ring;
+    liburingcxx::ring_simulator<uring_flags> sim{ring, ring_entries};
+
+    std::atomic<bool> running{true};
+    std::thread reaper{[&ring, &running] {
+        std::array<const liburingcxx::cq_entry *, ring_entries> cqes;
+        while (running.load(std::memory_order_relaxed)) {
+            const unsigned n = ring.peek_batch_cq_entries(cqes);
+            if (n != 0) {
+                ring.cq_advance(n);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }};
+
+    for (auto _ : state) {
+        while (ring.sq_space_left() < batch) {
+            std::this_thread::yield();
+        }
+        for (unsigned i = 0; i < batch; ++i) {
+            get_nop(ring);
+        }
+        ring.submit();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch);
+
+    running.store(false, std::memory_order_relaxed);
+    reaper.join();
+}
+
+#if LIBURINGCXX_BENCH_WITH_LIBURING
+/*****************************
+ *    liburing benchmarks    *
+ *****************************
+ */
+
+struct liburing_ring {
+    io_uring ring;
+
+    explicit liburing_ring(unsigned flags) {
+        const int ret = io_uring_queue_init(ring_entries, &ring, flags);
+        if (ret < 0) {
+            throw std::system_error{
+                -ret, std::system_category(), "io_uring_queue_init"
+            };
+        }
+    }
+
+    ~liburing_ring() noexcept { io_uring_queue_exit(&ring); }
+
+    liburing_ring(const liburing_ring &) = delete;
+    liburing_ring &operator=(const liburing_ring &) = delete;
+};
+
+void get_nop(io_uring &ring) noexcept {
+    io_uring_sqe *const sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_nop(sqe);
+    io_uring_sqe_set_data64(sqe, 0);
+}
+
+void reap(io_uring &ring, unsigned num, bool sqpoll) {
+    unsigned reaped = 0;
+    while (reaped < num) {
+        unsigned head;
+        unsigned n = 0;
+        io_uring_cqe *cqe;
+        io_uring_for_each_cqe(&ring, head, cqe) {
+            benchmark::DoNotOptimize(cqe->res);
+            ++n;
+        }
+        if (n == 0) {
+            if (!sqpoll) {
+                io_uring_wait_cqe(&ring, &cqe);
+            } else {
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        io_uring_cq_advance(&ring, n);
+        reaped += n;
+    }
+}
+
+template<uint64_t uring_flags>
+void BM_nop_liburing(benchmark::State &state) {
+    const auto batch = static_cast<unsigned>(state.range(0));
+    constexpr bool sqpoll = uring_flags & IORING_SETUP_SQPOLL;
+    liburing_ring r{static_cast<unsigned>(uring_flags)};
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < batch; ++i) {
+            get_nop(r.ring);
+        }
+        if constexpr (sqpoll) {
+            io_uring_submit(&r.ring);
+        } else {
+            io_uring_submit_and_wait(&r.ring, batch);
+        }
+        reap(r.ring, batch, sqpoll);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch);
+}
+
+void BM_get_sq_entry_liburing(benchmark::State &state) {
+    liburing_ring r{0};
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < ring_entries; ++i) {
+            get_nop(r.ring);
+        }
+        io_uring_submit_and_wait(&r.ring, ring_entries);
+        reap(r.ring, ring_entries, false);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * ring_entries);
+}
+
+void BM_peek_batch_liburing(benchmark::State &state) {
+    const auto batch = static_cast<unsigned>(state.range(0));
+    liburing_ring r{0};
+    std::array<io_uring_cqe *, ring_entries> cqes;
+
+    for (auto _ : state) {
+        for (unsigned i = 0; i < batch; ++i) {
+            get_nop(r.ring);
+        }
+        io_uring_submit_and_wait(&r.ring, batch);
+
+        unsigned reaped = 0;
+        while (reaped < batch) {
+            const unsigned n =
+                io_uring_peek_batch_cqe(&r.ring, cqes.data(), cqes.size());
+            benchmark::DoNotOptimize(cqes.data());
+            io_uring_cq_advance(&r.ring, n);
+            reaped += n;
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch);
+}
+
+void BM_enter_registered_liburing(benchmark::State &state) {
+    liburing_ring r{0};
+    io_uring_register_ring_fd(&r.ring);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(io_uring_get_events(&r.ring));
+    }
+}
+
+void BM_enter_plain_liburing(benchmark::State &state) {
+    liburing_ring r{0};
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(io_uring_get_events(&r.ring));
+    }
+}
+#endif
+
+} // namespace
+
+// NOP batch sizes: 1, 4, 16, 64, 256
+void batch_args(benchmark::internal::Benchmark *b) {
+    b->RangeMultiplier(4)->Range(1, ring_entries);
+}
+
+BENCHMARK(BM_nop_cxx<flags_default>)->Apply(batch_args);
+BENCHMARK(BM_nop_cxx<flags_reorder>)->Apply(batch_args);
+#if LIBURINGCXX_BENCH_WITH_LIBURING
+BENCHMARK(BM_nop_liburing<flags_default>)->Apply(batch_args);
+#endif
+
+BENCHMARK(BM_nop_cxx<flags_sqpoll>)->Apply(batch_args);
+#if LIBURINGCXX_BENCH_WITH_LIBURING
+BENCHMARK(BM_nop_liburing<flags_sqpoll>)->Apply(batch_args);
+#endif
+
+BENCHMARK(BM_sim_nop_cxx<flags_sqpoll>)->Apply(batch_args);
+BENCHMARK(BM_sim_nop_cxx<flags_sqpoll_reorder>)->Apply(batch_args);
+
+BENCHMARK(BM_sim_reaper_cxx<flags_sqpoll>)->Apply(batch_args)->UseRealTime();
+BENCHMARK(BM_sim_reaper_cxx<flags_sqpoll_separated>)
+    ->Apply(batch_args)
+    ->UseRealTime();
+
+BENCHMARK(BM_get_sq_entry_cxx<flags_default>);
+BENCHMARK(BM_get_sq_entry_cxx<flags_reorder>);
+#if LIBURINGCXX_BENCH_WITH_LIBURING
+BENCHMARK(BM_get_sq_entry_liburing);
+#endif
+
+BENCHMARK(BM_prep_read_cxx);
+BENCHMARK(BM_fill_read_cxx);
+BENCHMARK(BM_stamp_read_cxx<flags_sqpoll>);
+BENCHMARK(BM_stamp_read_cxx<flags_sqpoll_sqe128>);
+
+BENCHMARK(BM_peek_batch_cxx)->Apply(batch_args);
+#if LIBURINGCXX_BENCH_WITH_LIBURING
+BENCHMARK(BM_peek_batch_liburing)->Apply(batch_args);
+#endif
+
+BENCHMARK(BM_enter_registered_cxx);
+BENCHMARK(BM_enter_plain_cxx);
+#if LIBURINGCXX_BENCH_WITH_LIBURING
+BENCHMARK(BM_enter_registered_liburing);
+BENCHMARK(BM_enter_plain_liburing);
+#endif
+
+BENCHMARK_MAIN();
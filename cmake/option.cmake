@@ -13,3 +13,4 @@ endif()
 
 cmake_dependent_option(LIBURINGCXX_BUILD_EXAMPLE "Build examples of liburingcxx" ON "PROJECT_IS_TOP_LEVEL" OFF)
 cmake_dependent_option(LIBURINGCXX_BUILD_TEST "Build tests of liburingcxx" ON "PROJECT_IS_TOP_LEVEL" OFF)
+cmake_dependent_option(LIBURINGCXX_BUILD_BENCH "Build benchmarks of liburingcxx" ON "PROJECT_IS_TOP_LEVEL" OFF)
@@ -1,4 +1,6 @@
 #include "uring/uring.hpp"
+#include "uring/utility/context_pool.hpp"
+#include "uring/utility/user_data.hpp"
 
 #include <fcntl.h>
 #include <netinet/in.h>
@@ -16,6 +18,7 @@
 #define DEFAULT_SERVER_PORT 8000
 #define QUEUE_DEPTH         256
 #define READ_SZ             8192
+#define MAX_REQUESTS        1024
 
 #define EVENT_TYPE_ACCEPT 0
 #define EVENT_TYPE_READ   1
@@ -25,16 +28,27 @@
 #define MIN_MAJOR_VERSION  5
 
 struct request {
-    int event_type;
     unsigned int iovec_count;
     int client_socket;
-    struct iovec iov[];
+    struct iovec iov[6];
+    /* file contents to be freed once written, if any */
+    char *file_buf;
+    /* the read buffer, or storage of the response headers */
+    char buf[READ_SZ];
 };
 
-using uring = liburingcxx::uring<0>;
+using uring = liburingcxx::uring<liburingcxx::uring_setup::sqe_reorder>;
 
 uring ring;
 
+/*
+ * In-flight requests live in a fixed slab instead of one malloc each. The
+ * event type is the tag of user_data, so CQEs are dispatched without touching
+ * the request.
+ * */
+using request_data = liburingcxx::user_data_schema<uint8_t, 7, 24>;
+liburingcxx::context_pool<request, request_data> requests{MAX_REQUESTS};
+
 const char *unimplemented_content =
     "HTTP/1.0 400 Bad Request\r\n"
     "Content-type: text/html\r\n"
@@ -141,6 +155,18 @@ void *zh_malloc(size_t size) {
     return buf;
 }
 
+struct request *new_request(int client_socket) {
+    struct request *req = requests.emplace();
+    if (!req) {
+        fprintf(stderr, "Fatal error: too many in-flight requests.\n");
+        exit(1);
+    }
+    req->iovec_count = 0;
+    req->client_socket = client_socket;
+    req->file_buf = nullptr;
+    return req;
+}
+
 /*
  * This function is responsible for setting up the main listening socket used by
  * the web server.
@@ -190,9 +216,8 @@ int add_accept_request(
         client_addr_len, 0
     );
 
-    struct request *req = (request *)malloc(sizeof(*req));
-    req->event_type = EVENT_TYPE_ACCEPT;
-    sqe.set_data((uint64_t)req);
+    struct request *req = new_request(server_socket);
+    sqe.set_data(requests.user_data(req, EVENT_TYPE_ACCEPT));
     ring.append_sq_entry(&sqe);
     ring.submit();
 
@@ -201,16 +226,14 @@ int add_accept_request(
 
 int add_read_request(int client_socket) {
     auto &sqe = *ring.get_sq_entry();
-    struct request *req =
-        (request *)malloc(sizeof(*req) + sizeof(struct iovec));
-    req->iov[0].iov_base = malloc(READ_SZ);
+    struct request *req = new_request(client_socket);
+    req->iovec_count = 1;
+    req->iov[0].iov_base = req->buf;
     req->iov[0].iov_len = READ_SZ;
-    req->event_type = EVENT_TYPE_READ;
-    req->client_socket = client_socket;
-    std::memset(req->iov[0].iov_base, 0, READ_SZ);
+    std::memset(req->buf, 0, READ_SZ);
     /* Linux kernel 5.5 has support for readv, but not for recv() or read() */
     sqe.prep_readv(client_socket, {req->iov, 1}, 0);
-    sqe.set_data((uint64_t)req);
+    sqe.set_data(requests.user_data(req, EVENT_TYPE_READ));
     ring.append_sq_entry(&sqe);
     ring.submit();
     return 0;
@@ -218,23 +241,19 @@ int add_read_request(int client_socket) {
 
 int add_write_request(struct request *req) {
     auto &sqe = *ring.get_sq_entry();
-    req->event_type = EVENT_TYPE_WRITE;
     sqe.prep_writev(req->client_socket, {req->iov, req->iovec_count}, 0);
-    sqe.set_data((uint64_t)req);
+    sqe.set_data(requests.user_data(req, EVENT_TYPE_WRITE));
     ring.append_sq_entry(&sqe);
     ring.submit();
     return 0;
 }
 
 void _send_static_string_content(const char *str, int client_socket) {
-    struct request *req =
-        (request *)zh_malloc(sizeof(*req) + sizeof(struct iovec));
-    unsigned long slen = strlen(str);
+    struct request *req = new_request(client_socket);
     req->iovec_count = 1;
-    req->client_socket = client_socket;
-    req->iov[0].iov_base = zh_malloc(slen);
-    req->iov[0].iov_len = slen;
-    memcpy(req->iov[0].iov_base, str, slen);
+    /* the string is static, no need to copy it */
+    req->iov[0].iov_base = const_cast<char *>(str);
+    req->iov[0].iov_len = strlen(str);
     add_write_request(req);
 }
 
@@ -303,22 +322,30 @@ const char *get_filename_ext(const char *filename) {
  * signalling the end of headers and the beginning of any content.
  * */
 
-void send_headers(const char *path, off_t len, struct iovec *iov) {
+/*
+ * Copies a header line to `dest` and points `iov` at it. Returns the end of
+ * the copy.
+ * */
+
+char *copy_header(char *dest, struct iovec *iov, const char *str) {
+    unsigned long slen = strlen(str);
+    memcpy(dest, str, slen);
+    iov->iov_base = dest;
+    iov->iov_len = slen;
+    return dest + slen;
+}
+
+void send_headers(const char *path, off_t len, struct request *req) {
     char small_case_path[1024];
-    char send_buffer[1024];
+    char send_buffer[1024] = "";
     strcpy(small_case_path, path);
     strtolower(small_case_path);
 
-    const char *str = "HTTP/1.0 200 OK\r\n";
-    unsigned long slen = strlen(str);
-    iov[0].iov_base = zh_malloc(slen);
-    iov[0].iov_len = slen;
-    memcpy(iov[0].iov_base, str, slen);
-
-    slen = strlen(SERVER_STRING);
-    iov[1].iov_base = zh_malloc(slen);
-    iov[1].iov_len = slen;
-    memcpy(iov[1].iov_base, SERVER_STRING, slen);
+    /* headers are stored in the request itself instead of malloc */
+    struct iovec *iov = req->iov;
+    char *headers = req->buf;
+    headers = copy_header(headers, &iov[0], "HTTP/1.0 200 OK\r\n");
+    headers = copy_header(headers, &iov[1], SERVER_STRING);
 
     /*
      * Check the file extension for certain common types of files
@@ -354,27 +381,17 @@ void send_headers(const char *path, off_t len, struct iovec *iov) {
     if (strcmp("txt", file_ext) == 0) {
         strcpy(send_buffer, "Content-Type: text/plain\r\n");
     }
-    slen = strlen(send_buffer);
-    iov[2].iov_base = zh_malloc(slen);
-    iov[2].iov_len = slen;
-    memcpy(iov[2].iov_base, send_buffer, slen);
+    headers = copy_header(headers, &iov[2], send_buffer);
 
     /* Send the content-length header, which is the file size in this case. */
     sprintf(send_buffer, "content-length: %ld\r\n", len);
-    slen = strlen(send_buffer);
-    iov[3].iov_base = zh_malloc(slen);
-    iov[3].iov_len = slen;
-    memcpy(iov[3].iov_base, send_buffer, slen);
+    headers = copy_header(headers, &iov[3], send_buffer);
 
     /*
      * When the browser sees a '\r\n' sequence in a line on its own,
      * it understands there are no more headers. Content may follow.
      * */
-    strcpy(send_buffer, "\r\n");
-    slen = strlen(send_buffer);
-    iov[4].iov_base = zh_malloc(slen);
-    iov[4].iov_len = slen;
-    memcpy(iov[4].iov_base, send_buffer, slen);
+    copy_header(headers, &iov[4], "\r\n");
 }
 
 void handle_get_method(char *path, int client_socket) {
@@ -403,13 +420,11 @@ void handle_get_method(char *path, int client_socket) {
         /* Check if this is a normal/regular file and not a directory or
          * something else */
         if (S_ISREG(path_stat.st_mode)) {
-            struct request *req = reinterpret_cast<request *>(
-                zh_malloc(sizeof(*req) + (sizeof(struct iovec) * 6))
-            );
+            struct request *req = new_request(client_socket);
             req->iovec_count = 6;
-            req->client_socket = client_socket;
-            send_headers(final_path, path_stat.st_size, req->iov);
+            send_headers(final_path, path_stat.st_size, req);
             copy_file_contents(final_path, path_stat.st_size, &req->iov[5]);
+            req->file_buf = static_cast<char *>(req->iov[5].iov_base);
             printf("200 %s %ld bytes\n", final_path, path_stat.st_size);
             add_write_request(req);
         } else {
@@ -474,39 +489,44 @@ void server_loop(int server_socket) {
     const liburingcxx::cq_entry *cqe;
     while (1) {
         [[maybe_unused]] int err = ring.wait_cq_entry(cqe);
-        struct request *req = (struct request *)cqe->user_data;
+        const int event_type = request_data::tag(cqe->user_data);
+        struct request *req = requests.find(cqe->user_data);
+        if (!req) {
+            /* stale CQE of a request already released */
+            ring.seen_cq_entry(cqe);
+            continue;
+        }
         // if (ret < 0) fatal_error("io_uring_wait_cqe");
         if (cqe->res < 0) {
             fprintf(
                 stderr, "Async request failed: %s for event: %d\n",
-                strerror(-cqe->res), req->event_type
+                strerror(-cqe->res), event_type
             );
             exit(1);
         }
 
-        switch (req->event_type) {
+        switch (event_type) {
             case EVENT_TYPE_ACCEPT:
                 add_accept_request(
                     server_socket, &client_addr, &client_addr_len
                 );
                 add_read_request(cqe->res);
-                free(req);
+                requests.erase(req);
                 break;
             case EVENT_TYPE_READ:
                 if (!cqe->res) {
                     fprintf(stderr, "Empty request!\n");
+                    close(req->client_socket);
+                    requests.erase(req);
                     break;
                 }
                 handle_client_request(req);
-                free(req->iov[0].iov_base);
-                free(req);
+                requests.erase(req);
                 break;
             case EVENT_TYPE_WRITE:
-                for (unsigned i = 0; i < req->iovec_count; i++) {
-                    free(req->iov[i].iov_base);
-                }
+                free(req->file_buf);
                 close(req->client_socket);
-                free(req);
+                requests.erase(req);
                 break;
         }
         /* Mark this request as processed */
@@ -5,7 +5,9 @@
 #include <uring/uring_define.hpp>
 
 #include <cassert>
+#include <cstddef>
 #include <numeric>
+#include <span>
 
 namespace liburingcxx {
 
@@ -20,13 +22,25 @@ namespace detail {
     static_assert(sizeof(sq_entry) == 64);
     static_assert(alignof(sq_entry) == 8);
 
-    class submission_queue final {
+    /**
+     * @tparam cacheline_separated put the fields written by the submitting
+     * thread on their own cache line, apart from the read-only ones. See
+     * `uring_setup::cacheline_separated`.
+     */
+    template<bool cacheline_separated>
+    class basic_submission_queue final {
       private:
-        unsigned sqe_head;      // memset to 0 during uring()
-        unsigned sqe_tail;      // memset to 0 during uring()
-        unsigned sqe_free_head; // memset to 0 during uring()
+        template<typename T>
+        static constexpr size_t line_align =
+            cacheline_separated ? 64 : alignof(T);
 
-        unsigned *khead;
+        // written by the submitting thread
+        alignas(line_align<unsigned>) unsigned sqe_head; // memset to 0
+        unsigned sqe_tail;                               // memset to 0
+        unsigned sqe_free_head;                          // memset to 0
+
+        // read-only after init
+        alignas(line_align<unsigned *>) unsigned *khead;
         unsigned *ktail;
         unsigned ring_mask;
         unsigned ring_entries;
@@ -167,6 +181,43 @@ namespace detail {
             }
         }
 
+        /**
+         * @brief Reserve `out.size()` sqes at once, or none of them.
+         *
+         * @return false if there is not enough room
+         */
+        template<uint64_t uring_flags>
+        [[nodiscard]]
+        inline bool get_sq_entries(std::span<sq_entry *> out) noexcept {
+            constexpr int shift =
+                bool(uring_flags & IORING_SETUP_SQE128) ? 1 : 0;
+
+            unsigned int head;
+            if constexpr (!(uring_flags & IORING_SETUP_SQPOLL)) {
+                head = IO_URING_READ_ONCE(*khead);
+            } else {
+                head = io_uring_smp_load_acquire(khead);
+            }
+
+            const auto num = static_cast<unsigned>(out.size());
+            if constexpr (uring_flags & uring_setup::sqe_reorder) {
+                if (sqe_free_head - head + num > ring_entries) [[unlikely]] {
+                    return false;
+                }
+                for (sq_entry *&sqe : out) {
+                    sqe = &sqes[(array[sqe_free_head++ & ring_mask]) << shift];
+                }
+            } else {
+                if (sqe_tail - head + num > ring_entries) [[unlikely]] {
+                    return false;
+                }
+                for (sq_entry *&sqe : out) {
+                    sqe = &sqes[(sqe_tail++ & ring_mask) << shift];
+                }
+            }
+            return true;
+        }
+
         inline void append_sq_entry(const sq_entry *const sqe) noexcept {
             array[sqe_tail++ & ring_mask] = sqe - sqes;
             assert(sqe_tail - *khead <= ring_entries);
@@ -175,13 +226,35 @@ namespace detail {
       public:
         template<uint64_t uring_flags>
         friend class ::liburingcxx::uring;
-        submission_queue() noexcept = default;
-        ~submission_queue() noexcept = default;
+        basic_submission_queue() noexcept = default;
+        ~basic_submission_queue() noexcept = default;
+
+        /**
+         * @brief Whether the producer fields and the read-only group each
+         * start a 64-byte line of their own.
+         * @details Defined here because the class is only complete inside
+         * member function bodies; checked below.
+         */
+        static consteval bool is_line_separated() noexcept {
+            constexpr size_t producer =
+                offsetof(basic_submission_queue, sqe_head);
+            constexpr size_t read_only =
+                offsetof(basic_submission_queue, khead);
+            static_assert(offsetof(basic_submission_queue, sqe_free_head)
+                          < read_only);
+            return producer % 64 == 0 && read_only % 64 == 0
+                   && producer / 64 != read_only / 64;
+        }
     };
 
+    using submission_queue = basic_submission_queue<false>;
+
     // char (*____)[sizeof(submission_queue)] = 1;
 
     static_assert(sizeof(submission_queue) == 88);
+    static_assert(sizeof(basic_submission_queue<true>) == 192);
+    static_assert(basic_submission_queue<true>::is_line_separated());
+    static_assert(!submission_queue::is_line_separated());
 
 } // namespace detail
 
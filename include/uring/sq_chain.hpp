@@ -0,0 +1,129 @@
+#pragma once
+
+#include <uring/sq_entry.hpp>
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace liburingcxx {
+
+template<uint64_t uring_flags>
+class uring;
+
+/**
+ * @brief How the entries of an `sq_chain` are linked.
+ */
+enum class chain_link : uint8_t {
+    // IOSQE_IO_LINK, a failure cancels the rest of the chain
+    soft,
+    // IOSQE_IO_HARDLINK, the chain goes on regardless of failures
+    hard,
+};
+
+/**
+ * @brief `N` SQEs reserved together, to be submitted as one linked chain.
+ *
+ * @details Get one by `uring::get_sq_chain<N>(mode, skip_intermediate)`,
+ * prepare every entry, then `commit()` it before submitting. Since `prep_*`
+ * resets the flags of an entry, the link flags are set by `commit()`, after
+ * all entries are prepared. A chain destroyed uncommitted asserts.
+ *
+ * ```
+ * // only fsync posts a CQE on success
+ * auto chain = ring.get_sq_chain<2>(chain_link::soft, true);
+ * chain[0].prep_write(fd, buf, offset);
+ * chain[1].prep_fsync(fd, 0).set_data(data);
+ * chain.commit();
+ * ```
+ *
+ * If `uring_setup::sqe_reorder` is enabled, pass the chain to
+ * `uring::append_sq_chain()` instead, which commits it as well.
+ */
+template<size_t N>
+class [[nodiscard]] sq_chain final {
+    static_assert(N >= 1);
+
+  public:
+    sq_chain(sq_chain &&other) noexcept
+        : sqes(other.sqes)
+        , mode(other.mode)
+        , skip_intermediate(other.skip_intermediate)
+        , committed(std::exchange(other.committed, true)) {}
+
+    sq_chain(const sq_chain &) = delete;
+    sq_chain &operator=(const sq_chain &) = delete;
+    sq_chain &operator=(sq_chain &&) = delete;
+
+    ~sq_chain() noexcept {
+        assert((!*this || committed) && "The chain is not committed.");
+    }
+
+    [[nodiscard]]
+    static constexpr size_t size() noexcept {
+        return N;
+    }
+
+    /**
+     * @brief false if the SQ ring has not enough room for the chain
+     */
+    [[nodiscard]]
+    explicit operator bool() const noexcept {
+        return sqes[0] != nullptr;
+    }
+
+    [[nodiscard]]
+    sq_entry &operator[](size_t i) const noexcept {
+        assert(i < N && sqes[i] != nullptr);
+        return *sqes[i];
+    }
+
+    [[nodiscard]]
+    sq_entry &front() const noexcept {
+        return (*this)[0];
+    }
+
+    [[nodiscard]]
+    sq_entry &back() const noexcept {
+        return (*this)[N - 1];
+    }
+
+    /**
+     * @brief Set the link flag to all entries but the last one, once all of
+     * them are prepared. Must be called before the chain is submitted.
+     */
+    void commit() noexcept {
+        assert(*this && !committed);
+        for (size_t i = 0; i + 1 < N; ++i) {
+            sq_entry &sqe = *sqes[i];
+            if (mode == chain_link::hard) {
+                sqe.set_hard_link();
+            } else {
+                sqe.set_link();
+            }
+            if (skip_intermediate) {
+                sqe.set_cqe_skip();
+            }
+        }
+        committed = true;
+    }
+
+  private:
+    std::array<sq_entry *, N> sqes{};
+    chain_link mode;
+    // set `cqe_skip` to all entries but the last one, so a successful chain
+    // posts a single CQE. Failed entries still post their CQEs.
+    bool skip_intermediate;
+    bool committed = false;
+
+    sq_chain(chain_link mode, bool skip_intermediate) noexcept
+        : mode(mode)
+        , skip_intermediate(skip_intermediate) {}
+
+    template<uint64_t uring_flags>
+    friend class ::liburingcxx::uring;
+};
+
+} // namespace liburingcxx
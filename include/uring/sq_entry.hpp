@@ -2,14 +2,19 @@
 
 #include <uring/compat.hpp>
 #include <uring/io_uring.h>
+#include <uring/uring_define.hpp>
 #include <uring/utility/io_helper.hpp>
 #include <uring/utility/kernel_version.hpp>
 
+#include <bit>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <fcntl.h>
 #include <span>
 #include <sys/socket.h>
+#include <type_traits>
 #if LIBURINGCXX_HAS_OPENAT2
 #include <linux/openat2.h>
 #endif
@@ -23,16 +28,74 @@ namespace liburingcxx {
 template<uint64_t uring_flags>
 class uring;
 
+template<uint64_t uring_flags>
+class sqe_template;
+
 class sq_entry final : private io_uring_sqe {
+    // the word layout assumed by `fill_rw`
+    static_assert(offsetof(io_uring_sqe, fd) == 4);
+    static_assert(offsetof(io_uring_sqe, off) == 8);
+    static_assert(offsetof(io_uring_sqe, addr) == 16);
+    static_assert(offsetof(io_uring_sqe, len) == 24);
+    static_assert(offsetof(io_uring_sqe, rw_flags) == 28);
+    static_assert(offsetof(io_uring_sqe, user_data) == 32);
+
   public:
     template<uint64_t uring_flags>
     friend class ::liburingcxx::uring;
 
+    template<uint64_t uring_flags>
+    friend class ::liburingcxx::sqe_template;
+
     inline sq_entry &clone_from(const sq_entry &other) noexcept {
         std::memcpy(this, &other, sizeof(*this));
         return *this;
     }
 
+    /**
+     * @brief Same as `prep_rw(op, fd, addr, len, offset)` followed by
+     * `set_data(user_data)` and setting `flags`, but writes the whole sqe as
+     * eight aligned 8-byte words built in registers.
+     *
+     * @details `prep_rw` and the chained setters issue many narrow stores
+     * into the shared SQ memory. Building the sqe in a stack temporary and
+     * copying it is no better, since the wide loads of the copy stall on
+     * store forwarding. This path leaves a full 64-byte line of plain stores
+     * for the CPU to combine.
+     */
+    inline sq_entry &fill_rw(
+        uint8_t op,
+        int fd,
+        const void *addr,
+        uint32_t len,
+        uint64_t offset,
+        uint64_t user_data,
+        uint8_t flags = 0
+    ) noexcept {
+        if constexpr (std::endian::native != std::endian::little) {
+            prep_rw(op, fd, addr, len, offset).set_data(user_data);
+            this->flags = flags;
+        } else {
+            auto *const dst = reinterpret_cast<char *>(this);
+            const auto store = [dst](size_t i, uint64_t word) noexcept {
+                std::memcpy(dst + i * 8, &word, 8);
+            };
+            store(
+                0,
+                uint64_t(op) | uint64_t(flags) << 8
+                    | uint64_t(static_cast<uint32_t>(fd)) << 32
+            );
+            store(1, offset);
+            store(2, reinterpret_cast<uint64_t>(addr));
+            store(3, len); // rw_flags is 0
+            store(4, user_data);
+            store(5, 0); // buf_index, personality, file_index
+            store(6, 0); // addr3
+            store(7, 0); // __pad2[0]
+        }
+        return *this;
+    }
+
     inline sq_entry &set_data(uint64_t data) noexcept {
         this->user_data = data;
         return *this;
@@ -44,6 +107,8 @@ class sq_entry final : private io_uring_sqe {
 
     inline __u64 &fetch_data() noexcept { return this->user_data; }
 
+    [[nodiscard]] inline uint8_t get_flags() const noexcept { return flags; }
+
     inline sq_entry &reset_flags(uint8_t flags) noexcept {
         this->flags = flags;
         return *this;
@@ -81,6 +146,12 @@ class sq_entry final : private io_uring_sqe {
         return *this;
     }
 
+    // Select a buffer from the provided buffer group `buf_group`
+    inline sq_entry &set_buffer_select(uint16_t buf_group) noexcept {
+        this->buf_group = buf_group;
+        return set_buffer_select();
+    }
+
 #if LIBURINGCXX_IS_KERNEL_REACH(5, 17)
     // see `man io_uring_enter`
     // available since Linux 5.17
@@ -89,6 +160,23 @@ class sq_entry final : private io_uring_sqe {
         return *this;
     }
 
+    /**
+     * @brief Post no CQE on success, and mark the `user_data` so a failure
+     * can be told apart from other CQEs.
+     *
+     * @details Nothing has to outlive the submission, so the caller may
+     * release the op context right away. Must be called after `prep_*`,
+     * which resets the flags. Requires IORING_FEAT_CQE_SKIP (Linux 5.17).
+     *
+     * @param data payload for the failure handler, e.g. the fd to be closed.
+     * Must keep `fire_and_forget_flag` clear.
+     */
+    inline sq_entry &set_fire_and_forget(uint64_t data = 0) noexcept {
+        assert(!(data & fire_and_forget_flag));
+        this->user_data = data | fire_and_forget_flag;
+        return set_cqe_skip();
+    }
+
     [[nodiscard]] inline bool is_cqe_skip() const noexcept {
         return (this->flags & IOSQE_CQE_SKIP_SUCCESS);
     }
@@ -402,6 +490,39 @@ class sq_entry final : private io_uring_sqe {
         return *this;
     }
 
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 19)
+    /**
+     * @brief Cancel every in-flight request of `fd`.
+     *
+     * @details `res` of the CQE is the number of canceled requests, or
+     * -ENOENT if there is none.
+     */
+    inline sq_entry &prep_cancle_fd_all(int fd) noexcept {
+        return prep_cancle_fd(fd, IORING_ASYNC_CANCEL_ALL);
+    }
+
+    /**
+     * @brief Cancel every in-flight request of the ring.
+     *
+     * @details `res` of the CQE is the number of canceled requests, or
+     * -ENOENT if there is none.
+     */
+    inline sq_entry &prep_cancle_any() noexcept {
+        return prep_cancle(
+            uint64_t(0), IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL
+        );
+    }
+#endif
+
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 0)
+    inline sq_entry &
+    prep_cancle_fd_fixed(unsigned file_index, unsigned int flags) noexcept {
+        return prep_cancle_fd(
+            static_cast<int>(file_index), flags | IORING_ASYNC_CANCEL_FD_FIXED
+        );
+    }
+#endif
+
     inline sq_entry &
     prep_link_timeout(const __kernel_timespec &ts, unsigned flags) noexcept {
         prep_rw(IORING_OP_LINK_TIMEOUT, -1, &ts, 1, 0);
@@ -836,6 +957,86 @@ class sq_entry final : private io_uring_sqe {
             domain, type, protocol, IORING_FILE_INDEX_ALLOC - 1, flags
         );
     }
+
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 19)
+    // bytes of the command area of an sqe, from `cmd` to the end
+    static constexpr size_t cmd_size =
+        sizeof(io_uring_sqe) - offsetof(io_uring_sqe, cmd);
+    // ... with IORING_SETUP_SQE128
+    static constexpr size_t cmd_size_sqe128 = cmd_size + sizeof(io_uring_sqe);
+
+    /**
+     * @brief The command area of IORING_OP_URING_CMD, `cmd_size` bytes, or
+     * `cmd_size_sqe128` bytes with IORING_SETUP_SQE128.
+     */
+    [[nodiscard]]
+    inline void *get_cmd() noexcept {
+        return reinterpret_cast<char *>(this) + offsetof(io_uring_sqe, cmd);
+    }
+
+    /**
+     * @brief Prepare a command of `cmd_op` to the driver of `fd`.
+     *
+     * @details The command area is left untouched. Fill it by `get_cmd`, or
+     * use `uring::prep_uring_cmd` to copy a typed payload.
+     */
+    inline sq_entry &prep_uring_cmd(uint32_t cmd_op, int fd) noexcept {
+        prep_rw(IORING_OP_URING_CMD, fd, nullptr, 0, 0);
+        this->cmd_op = cmd_op;
+        return *this;
+    }
+#endif
+
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 7)
+    /**
+     * @brief Prepare a socket command, same as io_uring_prep_cmd_sock().
+     *
+     * @param cmd_op SOCKET_URING_OP_*
+     */
+    inline sq_entry &prep_cmd_sock(
+        uint32_t cmd_op,
+        int fd,
+        int level,
+        int optname,
+        void *optval,
+        int optlen
+    ) noexcept {
+        prep_uring_cmd(cmd_op, fd);
+        this->optval = reinterpret_cast<uint64_t>(optval);
+        this->level = static_cast<uint32_t>(level);
+        this->optname = static_cast<uint32_t>(optname);
+        this->optlen = static_cast<uint32_t>(optlen);
+        return *this;
+    }
+
+    // `res` is the number of unread bytes in the receive queue
+    inline sq_entry &prep_sock_siocinq(int fd) noexcept {
+        return prep_cmd_sock(SOCKET_URING_OP_SIOCINQ, fd, 0, 0, nullptr, 0);
+    }
+
+    // `res` is the number of unsent bytes in the send queue
+    inline sq_entry &prep_sock_siocoutq(int fd) noexcept {
+        return prep_cmd_sock(SOCKET_URING_OP_SIOCOUTQ, fd, 0, 0, nullptr, 0);
+    }
+
+    // `res` is the length of the option value written to `optval`
+    inline sq_entry &prep_getsockopt(
+        int fd, int level, int optname, void *optval, int optlen
+    ) noexcept {
+        return prep_cmd_sock(
+            SOCKET_URING_OP_GETSOCKOPT, fd, level, optname, optval, optlen
+        );
+    }
+
+    inline sq_entry &prep_setsockopt(
+        int fd, int level, int optname, const void *optval, int optlen
+    ) noexcept {
+        return prep_cmd_sock(
+            SOCKET_URING_OP_SETSOCKOPT, fd, level, optname,
+            const_cast<void *>(optval), optlen
+        );
+    }
+#endif
 };
 
 } // namespace liburingcxx
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <uring/sq_entry.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace liburingcxx {
+
+/**
+ * @brief A precomputed sqe image for repetitive operations.
+ *
+ * @details Prepare the image once, then `stamp` it into each sqe. A stamp is
+ * a fixed-size copy of the image (64 bytes, or 128 bytes with
+ * IORING_SETUP_SQE128), which compiles into a few wide stores, followed by
+ * patching the fields that vary. It is cheaper than `prep_*`, which rewrites
+ * the sqe field by field.
+ *
+ * ```
+ * sqe_template<uring_flags> tpl;
+ * tpl.image().prep_read(file_index, {}, 0).set_fixed_file();
+ * for (...) {
+ *     tpl.stamp(*ring.get_sq_entry(), buf, len, offset, data);
+ * }
+ * ```
+ *
+ * @tparam uring_flags same as the ring to be stamped into
+ */
+template<uint64_t uring_flags>
+class sqe_template final {
+    static constexpr int shift =
+        bool(uring_flags & IORING_SETUP_SQE128) ? 1 : 0;
+
+  public:
+    static constexpr size_t image_size = sizeof(sq_entry) << shift;
+
+    sqe_template() noexcept { std::memset(images, 0, image_size); }
+
+    /**
+     * @brief The image to be prepared by `prep_*` and `set_*`.
+     *
+     * @details With IORING_SETUP_SQE128, the 64 bytes following it are the
+     * second half of the image.
+     */
+    [[nodiscard]]
+    sq_entry &image() noexcept {
+        return images[0];
+    }
+
+    [[nodiscard]]
+    const sq_entry &image() const noexcept {
+        return images[0];
+    }
+
+    /**
+     * @brief Copy the image into `sqe` as it is.
+     */
+    sq_entry &stamp(sq_entry &sqe) const noexcept {
+        std::memcpy(&sqe, images, image_size);
+        return sqe;
+    }
+
+    /**
+     * @brief Copy the image into `sqe`, then patch `user_data`.
+     */
+    sq_entry &stamp(sq_entry &sqe, uint64_t user_data) const noexcept {
+        return stamp(sqe).set_data(user_data);
+    }
+
+    /**
+     * @brief Copy the image into `sqe`, then patch the buffer, offset and
+     * `user_data` of a read/write-like operation.
+     */
+    sq_entry &stamp(
+        sq_entry &sqe,
+        const void *addr,
+        uint32_t len,
+        uint64_t offset,
+        uint64_t user_data
+    ) const noexcept {
+        stamp(sqe);
+        sqe.addr = reinterpret_cast<uint64_t>(addr);
+        sqe.len = len;
+        sqe.off = offset;
+        sqe.user_data = user_data;
+        return sqe;
+    }
+
+  private:
+    alignas(64) sq_entry images[1 << shift];
+};
+
+} // namespace liburingcxx
@@ -33,26 +33,33 @@
 #include <uring/detail/int_flags.h>
 #include <uring/detail/sq.hpp>
 #include <uring/io_uring.h>
+#include <uring/sq_chain.hpp>
+#include <uring/sqe_template.hpp>
 #include <uring/syscall.hpp>
 #include <uring/uring_define.hpp>
 #include <uring/utility/kernel_version.hpp>
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cinttypes>
 #include <concepts>
 #include <csignal>
 #include <cstdint>
+#include <cstring>
 #include <ctime>
 #include <linux/swab.h>
 #include <sched.h>
+#include <span>
 #include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
 #include <system_error>
 #include <type_traits>
+#include <unistd.h>
 #include <utility>
 
 struct statx;
@@ -74,7 +81,25 @@ namespace config {
 
 constexpr uint64_t LIBURING_UDATA_TIMEOUT = -1ULL;
 
+namespace detail {
+
+// of 6.13, newer than <uring/io_uring.h>
+inline constexpr unsigned IORING_REGISTER_RESIZE_RINGS = 33;
+
+} // namespace detail
+
 struct uring_params final : io_uring_params {
+    /**
+     * @brief Setup flags which only take effect at runtime, so they are kept
+     * by `uring::init` instead of being overridden by `uring_flags`.
+     */
+    static constexpr uint32_t runtime_flags =
+        IORING_SETUP_SQ_AFF | IORING_SETUP_ATTACH_WQ | IORING_SETUP_R_DISABLED
+        | IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+
+    // IORING_MAX_CQ_ENTRIES of the kernel
+    static constexpr unsigned max_cq_entries = 65536;
+
     /**
      * @brief Construct a new io_uring_params without initializing
      */
@@ -87,6 +112,147 @@ struct uring_params final : io_uring_params {
         std::memset(this, 0, sizeof(*this));
         this->flags = flags;
     }
+
+    /**
+     * @brief Pin the SQPOLL kernel thread to `cpu`. (IORING_SETUP_SQ_AFF)
+     */
+    uring_params &set_sq_thread_cpu(unsigned cpu) noexcept {
+        this->flags |= IORING_SETUP_SQ_AFF;
+        this->sq_thread_cpu = cpu;
+        return *this;
+    }
+
+    /**
+     * @brief How long the SQPOLL kernel thread spins before it sleeps.
+     */
+    uring_params &set_sq_thread_idle(std::chrono::milliseconds idle) noexcept {
+        this->sq_thread_idle = static_cast<uint32_t>(idle.count());
+        return *this;
+    }
+
+    /**
+     * @brief Share the SQPOLL kernel thread and io-wq of the ring `wq_fd`.
+     * (IORING_SETUP_ATTACH_WQ)
+     */
+    uring_params &set_attach_wq(int wq_fd) noexcept {
+        this->flags |= IORING_SETUP_ATTACH_WQ;
+        this->wq_fd = static_cast<uint32_t>(wq_fd);
+        return *this;
+    }
+
+    /**
+     * @brief Size the CQ ring apart from the SQ ring. (IORING_SETUP_CQSIZE)
+     *
+     * @param entries rounded up to pow of 2 by the kernel. Must not be less
+     * than the SQ entries.
+     */
+    uring_params &set_cq_entries(unsigned entries) noexcept {
+        this->flags |= IORING_SETUP_CQSIZE;
+        this->cq_entries = entries;
+        return *this;
+    }
+
+    /**
+     * @brief Clamp too large SQ/CQ entries to the kernel limits, instead of
+     * failing with EINVAL. (IORING_SETUP_CLAMP)
+     */
+    uring_params &set_clamp() noexcept {
+        this->flags |= IORING_SETUP_CLAMP;
+        return *this;
+    }
+
+    /**
+     * @brief Recommend CQ entries for `sq_entries` in flight, each of which
+     * posts up to `cqes_per_sqe` cqes before they are reaped, e.g. multishot
+     * accept or recv.
+     *
+     * @details At least the default twice of `sq_entries`, rounded up to pow
+     * of 2 and capped at `max_cq_entries`.
+     */
+    [[nodiscard]]
+    static constexpr unsigned
+    recommend_cq_entries(unsigned sq_entries, unsigned cqes_per_sqe) noexcept {
+        const uint64_t want = std::max<uint64_t>(
+            uint64_t(sq_entries) * cqes_per_sqe, uint64_t(sq_entries) * 2
+        );
+        const uint64_t capped = std::min<uint64_t>(want, max_cq_entries);
+        return static_cast<unsigned>(std::bit_ceil(capped));
+    }
+
+    /**
+     * @brief Start the ring disabled, see `uring::enable_rings`.
+     * (IORING_SETUP_R_DISABLED)
+     */
+    uring_params &set_disabled() noexcept {
+        this->flags |= IORING_SETUP_R_DISABLED;
+        return *this;
+    }
+};
+
+/**
+ * @brief Factories of `io_uring_restriction`, see
+ * `uring::register_restrictions`.
+ */
+struct uring_restriction final {
+    uring_restriction() = delete;
+
+    /**
+     * @brief Allow the io_uring_register opcode `op`, e.g.
+     * IORING_REGISTER_BUFFERS.
+     */
+    [[nodiscard]]
+    static io_uring_restriction allow_register_op(uint8_t op) noexcept {
+        io_uring_restriction res{};
+        res.opcode = IORING_RESTRICTION_REGISTER_OP;
+        res.register_op = op;
+        return res;
+    }
+
+    /**
+     * @brief Allow the sqe opcode `op`, e.g. IORING_OP_READ.
+     */
+    [[nodiscard]]
+    static io_uring_restriction allow_sqe_op(uint8_t op) noexcept {
+        io_uring_restriction res{};
+        res.opcode = IORING_RESTRICTION_SQE_OP;
+        res.sqe_op = op;
+        return res;
+    }
+
+    /**
+     * @brief Allow the sqe `flags`, e.g. IOSQE_FIXED_FILE.
+     */
+    [[nodiscard]]
+    static io_uring_restriction allow_sqe_flags(uint8_t flags) noexcept {
+        io_uring_restriction res{};
+        res.opcode = IORING_RESTRICTION_SQE_FLAGS_ALLOWED;
+        res.sqe_flags = flags;
+        return res;
+    }
+
+    /**
+     * @brief Require every sqe to set `flags`.
+     */
+    [[nodiscard]]
+    static io_uring_restriction require_sqe_flags(uint8_t flags) noexcept {
+        io_uring_restriction res{};
+        res.opcode = IORING_RESTRICTION_SQE_FLAGS_REQUIRED;
+        res.sqe_flags = flags;
+        return res;
+    }
+};
+
+template<uint64_t uring_flags>
+class ring_simulator;
+
+/**
+ * @brief Limits of io-wq workers, see `uring::register_iowq_max_workers`.
+ */
+struct iowq_max_workers final {
+    // workers for bounded work, e.g. regular file I/O
+    unsigned bounded;
+    // workers for unbounded work, e.g. socket I/O
+    unsigned unbounded;
 };
 
 struct __peek_cq_entry_return_type /*NOLINT*/ final {
@@ -101,21 +267,29 @@ class [[nodiscard]] uring final {
     using params = uring_params;
 
   private:
-    using submission_queue = detail::submission_queue;
+    static constexpr bool cacheline_separated =
+        uring_flags & uring_setup::cacheline_separated;
+    template<typename T>
+    static constexpr size_t line_align = cacheline_separated ? 64 : alignof(T);
+
+    using submission_queue =
+        detail::basic_submission_queue<cacheline_separated>;
     using completion_queue = detail::completion_queue;
 
     submission_queue sq;
-    completion_queue cq;
+    alignas(line_align<completion_queue>) completion_queue cq;
     // unsigned flags; // is now uring_flags
-    int ring_fd = -1;
+    alignas(line_align<int>) int ring_fd = -1;
 
     unsigned features;
-    int enter_ring_fd;
+    int enter_ring_fd = -1;
     __u8 int_flags;
     __u8 pad[3];
-    unsigned pad2;
+    // the thread owning the slot `enter_ring_fd` if INT_FLAG_REG_RING is set
+    pid_t reg_tid;
 
   public:
+    // -1 with IORING_SETUP_REGISTERED_FD_ONLY
     int fd() const noexcept { return ring_fd; }
 
     int submit() noexcept;
@@ -144,11 +318,23 @@ class [[nodiscard]] uring final {
     [[nodiscard]]
     unsigned get_sq_ring_entries() const noexcept;
 
+    [[nodiscard]]
+    unsigned get_cq_ring_entries() const noexcept;
+
     [[nodiscard]]
     sq_entry *get_sq_entry() noexcept;
 
     void append_sq_entry(const sq_entry *sqe) noexcept;
 
+    template<size_t N>
+    [[nodiscard]]
+    sq_chain<N> get_sq_chain(
+        chain_link mode = chain_link::soft, bool skip_intermediate = false
+    ) noexcept;
+
+    template<size_t N>
+    void append_sq_chain(sq_chain<N> &chain) noexcept;
+
     int wait_sq_ring();
 
     [[nodiscard]]
@@ -189,14 +375,144 @@ class [[nodiscard]] uring final {
         return count;
     }
 
+    /**
+     * @brief Like `for_each_cqe(f)`, but CQEs of failed fire-and-forget sqes
+     * go to `on_failure` instead of `f`.
+     *
+     * @details See `sq_entry::set_fire_and_forget()`. The payload is
+     * `cqe->user_data & ~fire_and_forget_flag`.
+     */
+    template<typename F, typename E>
+        requires std::regular_invocable<F, cq_entry *>
+                 && std::is_void_v<std::invoke_result_t<F, cq_entry *>>
+                 && std::regular_invocable<E, cq_entry *>
+                 && std::is_void_v<std::invoke_result_t<E, cq_entry *>>
+    unsigned for_each_cqe(F f, E on_failure) noexcept(
+        noexcept(f(std::declval<cq_entry *>()))
+        && noexcept(on_failure(std::declval<cq_entry *>()))
+    ) {
+        return for_each_cqe([&](cq_entry *cqe) {
+            if (cqe->user_data & fire_and_forget_flag) [[unlikely]] {
+                on_failure(cqe);
+            } else {
+                f(cqe);
+            }
+        });
+    }
+
     void cq_advance(unsigned num) noexcept;
 
+    /**
+     * @brief The extra 16 bytes of a CQE, only on rings set up with
+     * IORING_SETUP_CQE32.
+     */
+    [[nodiscard]]
+    static std::span<const __u64, 2> big_cqe(const cq_entry &cqe) noexcept
+        requires(bool(uring_flags & IORING_SETUP_CQE32))
+    {
+        return std::span<const __u64, 2>{cqe.big_cqe, 2};
+    }
+
+    /**
+     * @brief The extra 16 bytes of a CQE as `T`, e.g. the result of a
+     * uring_cmd. Only on rings set up with IORING_SETUP_CQE32.
+     */
+    template<typename T>
+        requires(bool(uring_flags & IORING_SETUP_CQE32))
+                && std::is_trivially_copyable_v<T>
+                && (sizeof(T) <= 2 * sizeof(__u64))
+    [[nodiscard]]
+    static T big_cqe_as(const cq_entry &cqe) noexcept {
+        T value;
+        std::memcpy(&value, cqe.big_cqe, sizeof(T));
+        return value;
+    }
+
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 19)
+    // bytes of the command area of an sqe of this ring
+    static constexpr size_t cmd_area_size =
+        bool(uring_flags & IORING_SETUP_SQE128) ? sq_entry::cmd_size_sqe128
+                                                : sq_entry::cmd_size;
+
+    /**
+     * @brief Prepare a command of `cmd_op` to the driver of `fd`, with `cmd`
+     * copied into the command area and the rest of the area zeroed.
+     *
+     * @details A `Cmd` larger than `sq_entry::cmd_size` only fits on rings
+     * set up with IORING_SETUP_SQE128.
+     */
+    template<typename Cmd>
+        requires std::is_trivially_copyable_v<Cmd>
+                 && (sizeof(Cmd) <= cmd_area_size)
+    static sq_entry &prep_uring_cmd(
+        sq_entry &sqe, uint32_t cmd_op, int fd, const Cmd &cmd
+    ) noexcept {
+        sqe.prep_uring_cmd(cmd_op, fd);
+        auto *const area = static_cast<char *>(sqe.get_cmd());
+        std::memcpy(area, &cmd, sizeof(Cmd));
+        std::memset(area + sizeof(Cmd), 0, cmd_area_size - sizeof(Cmd));
+        return sqe;
+    }
+#endif
+
     void seen_cq_entry(const cq_entry *cqe) noexcept;
 
     int register_ring_fd();
 
     int unregister_ring_fd();
 
+    int register_buffers(std::span<const iovec> iovecs);
+
+    int unregister_buffers();
+
+    int register_files(std::span<const int> fds);
+
+    int unregister_files();
+
+    int register_restrictions(std::span<const io_uring_restriction> res);
+
+    int enable_rings();
+
+    int register_eventfd(int event_fd, bool async_only = false);
+
+    int unregister_eventfd();
+
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 8)
+    void set_cq_eventfd_enabled(bool enabled);
+
+    [[nodiscard]]
+    bool is_cq_eventfd_enabled() const noexcept;
+#endif
+
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 15)
+    int register_iowq_aff(const cpu_set_t &mask);
+
+    int unregister_iowq_aff();
+
+    iowq_max_workers register_iowq_max_workers(iowq_max_workers limits);
+#endif
+
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 0)
+    int sync_cancel(
+        uint64_t user_data,
+        unsigned flags,
+        const __kernel_timespec &timeout = {-1, -1}
+    ) noexcept;
+
+    int sync_cancel_fd(
+        int fd,
+        bool is_fixed = false,
+        const __kernel_timespec &timeout = {-1, -1}
+    ) noexcept;
+
+    int sync_cancel_all(const __kernel_timespec &timeout = {-1, -1}) noexcept;
+#endif
+
+    [[nodiscard]]
+    buf_ring &setup_buf_ring(unsigned entries, uint16_t bgid);
+
+    void free_buf_ring(buf_ring &br, unsigned entries, uint16_t bgid) noexcept;
+
     [[nodiscard]]
     constexpr bool is_cq_ring_need_enter() const noexcept;
 
@@ -210,6 +526,14 @@ class [[nodiscard]] uring final {
     void init(unsigned entries, params &params);
     void init(unsigned entries, params &&params);
 
+    void resize(unsigned sq_entries, unsigned cq_entries = 0)
+        requires(
+            bool(uring_flags & IORING_SETUP_DEFER_TASKRUN)
+            && !(uring_flags & IORING_SETUP_NO_MMAP)
+        );
+
+    void migrate(unsigned sq_entries, unsigned cq_entries = 0);
+
     explicit uring() noexcept = default;
 
     /**
@@ -220,17 +544,42 @@ class [[nodiscard]] uring final {
     uring &operator=(const uring &) = delete;
     uring &operator=(uring &&) = delete;
 
+    /**
+     * @note The registered ring fd is unregistered only on the thread which
+     * registered it. Elsewhere its slot is left until that thread exits.
+     */
     ~uring() noexcept;
 
   private:
+    int do_register(unsigned opcode, const void *arg, unsigned nr_args)
+        const noexcept;
+
     int __submit /*NOLINT*/ (
         unsigned submitted, unsigned wait_num, bool getevents
     ) noexcept;
 
     void mmap_queue(int fd, params &p);
 
+    static size_t alloc_app_mem(unsigned entries, params &p);
+
+    void attach_rings(
+        const params &p, void *sq_ring_ptr, void *cq_ring_ptr, sq_entry *sqes
+    ) noexcept;
+
     void unmap_rings() noexcept;
 
+    void close_ring() noexcept;
+
+    // forget the rings and fds, without releasing them
+    void reset_state() noexcept {
+        sq = {};
+        cq = {};
+        ring_fd = enter_ring_fd = -1;
+        features = 0;
+        int_flags = 0;
+        reg_tid = 0;
+    }
+
     constexpr bool is_sq_ring_need_enter(unsigned submit, unsigned &enter_flags)
         const noexcept;
 
@@ -263,6 +612,12 @@ class [[nodiscard]] uring final {
         sigset_t *sigmask
     ) noexcept;
 #endif
+
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 0)
+    int sync_cancel_until_idle(const io_uring_sync_cancel_reg &reg) noexcept;
+#endif
+
+    friend class ring_simulator<uring_flags>;
 };
 
 /***************************************
@@ -354,6 +709,11 @@ inline unsigned uring<uring_flags>::get_sq_ring_entries() const noexcept {
     return sq.ring_entries;
 }
 
+template<uint64_t uring_flags>
+inline unsigned uring<uring_flags>::get_cq_ring_entries() const noexcept {
+    return cq.ring_entries;
+}
+
 /**
  * @brief Return an sqe to fill. User must later call submit().
  *
@@ -385,6 +745,48 @@ void uring<uring_flags>::append_sq_entry(const sq_entry *sqe) noexcept {
     sq.append_sq_entry(sqe);
 }
 
+/**
+ * @brief Reserve `N` sqes at once for a linked chain. User must later call
+ * submit().
+ *
+ * @details Either all `N` sqes are reserved or none, so a chain is never cut
+ * by a full SQ ring. The entries are linked by `sq_chain::commit()`.
+ *
+ * @param mode how the entries are linked
+ * @param skip_intermediate set `cqe_skip` to all entries but the last one,
+ * so a successful chain posts a single CQE
+ * @return sq_chain<N> evaluates to false if the SQ ring has not enough room.
+ */
+template<uint64_t uring_flags>
+template<size_t N>
+inline sq_chain<N> uring<uring_flags>::get_sq_chain(
+    chain_link mode, bool skip_intermediate
+) noexcept {
+    static_assert(N >= 1);
+    sq_chain<N> chain{mode, skip_intermediate};
+    if (!sq.template get_sq_entries<uring_flags>(chain.sqes)) [[unlikely]] {
+        chain.sqes[0] = nullptr;
+    }
+    return chain;
+}
+
+/**
+ * @brief Commit a chain if it is not yet, and append all its entries to SQ in
+ * order, but do not notify the io_uring.
+ *
+ * @details Only for `uring_setup::sqe_reorder`, like `append_sq_entry()`.
+ */
+template<uint64_t uring_flags>
+template<size_t N>
+inline void uring<uring_flags>::append_sq_chain(sq_chain<N> &chain) noexcept {
+    if (!chain.committed) {
+        chain.commit();
+    }
+    for (sq_entry *const sqe : chain.sqes) {
+        append_sq_entry(sqe);
+    }
+}
+
 /**
  * @brief wait until the SQ ring is not full
  *
@@ -544,6 +946,10 @@ uring<uring_flags>::seen_cq_entry([[maybe_unused]] const cq_entry *cqe
 template<uint64_t uring_flags>
 int uring<uring_flags>::register_ring_fd() {
     assert(config::using_register_ring_fd && "kernel version < 5.18"); // NOLINT
+    assert(
+        !(uring_flags & IORING_SETUP_REGISTERED_FD_ONLY)
+        && "The ring is only a registered ring fd."
+    );
 
     struct io_uring_rsrc_update up = {
         .offset = -1U,
@@ -558,6 +964,7 @@ int uring<uring_flags>::register_ring_fd() {
     if (ret == 1) [[likely]] {
         this->enter_ring_fd = up.offset;
         this->int_flags |= INT_FLAG_REG_RING;
+        this->reg_tid = ::gettid();
     } else if (ret < 0) {
         throw std::system_error{
             -ret, std::system_category(), "uring::register_ring_fd"
@@ -570,9 +977,19 @@ int uring<uring_flags>::register_ring_fd() {
 template<uint64_t uring_flags>
 int uring<uring_flags>::unregister_ring_fd() {
     assert(config::using_register_ring_fd && "kernel version < 5.18"); // NOLINT
+    assert(
+        !(uring_flags & IORING_SETUP_REGISTERED_FD_ONLY)
+        && "The ring is only a registered ring fd."
+    );
+    assert(
+        this->reg_tid == ::gettid()
+        && "The ring fd is registered by another thread."
+    );
 
     struct io_uring_rsrc_update up = {
-        .offset = this->enter_ring_fd,
+        .offset = unsigned(this->enter_ring_fd),
+        .resv = 0,
+        .data = 0,
     };
 
     const int ret = __sys_io_uring_register(
@@ -591,15 +1008,423 @@ int uring<uring_flags>::unregister_ring_fd() {
     return ret;
 }
 
+/**
+ * @brief Register buffers for `prep_read_fixed` and `prep_write_fixed`.
+ *
+ * @param iovecs `buf_index` of the SQE is the index into `iovecs`
+ * @return 0 on success
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::register_buffers(std::span<const iovec> iovecs) {
+    const int ret =
+        do_register(IORING_REGISTER_BUFFERS, iovecs.data(), iovecs.size());
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::register_buffers"
+        };
+    }
+    return ret;
+}
+
+template<uint64_t uring_flags>
+int uring<uring_flags>::unregister_buffers() {
+    const int ret = do_register(IORING_UNREGISTER_BUFFERS, nullptr, 0);
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::unregister_buffers"
+        };
+    }
+    return ret;
+}
+
+/**
+ * @brief Register files for `sq_entry::set_fixed_file`.
+ *
+ * @param fds the fd of an SQE is the index into `fds`. -1 makes a sparse
+ * slot.
+ * @return 0 on success
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::register_files(std::span<const int> fds) {
+    const int ret = do_register(IORING_REGISTER_FILES, fds.data(), fds.size());
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::register_files"
+        };
+    }
+    return ret;
+}
+
+template<uint64_t uring_flags>
+int uring<uring_flags>::unregister_files() {
+    const int ret = do_register(IORING_UNREGISTER_FILES, nullptr, 0);
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::unregister_files"
+        };
+    }
+    return ret;
+}
+
+/**
+ * @brief Restrict what can be done with this ring once it is enabled.
+ *
+ * @details Only sqe opcodes, sqe flags and register opcodes listed in `res`
+ * are allowed after `enable_rings`. It can be called only once, on a ring
+ * inited with `uring_params::set_disabled`.
+ *
+ * @note `~uring` unregisters the registered ring fd, so allow
+ * IORING_UNREGISTER_RING_FDS if the slot should be released before the
+ * thread exits.
+ *
+ * @return 0 on success
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::register_restrictions(
+    std::span<const io_uring_restriction> res
+) {
+    const int ret =
+        do_register(IORING_REGISTER_RESTRICTIONS, res.data(), res.size());
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::register_restrictions"
+        };
+    }
+    return ret;
+}
+
+/**
+ * @brief Enable a ring inited with `uring_params::set_disabled`.
+ *
+ * @details A disabled ring accepts registrations but no submissions, and its
+ * SQPOLL thread is not started. It allows a ring to be fully set up before
+ * the first sqe, and then handed over to less-trusted code:
+ *
+ * ```
+ * uring<0> ring;
+ * ring.init(256, uring_params{0}.set_disabled());
+ * ring.register_files(fds);
+ * ring.register_buffers(iovecs);
+ * const io_uring_restriction res[] = {
+ *     uring_restriction::allow_sqe_op(IORING_OP_READ_FIXED),
+ *     uring_restriction::allow_sqe_flags(IOSQE_FIXED_FILE),
+ * };
+ * ring.register_restrictions(res);
+ * ring.enable_rings();
+ * ```
+ *
+ * @return 0 on success
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::enable_rings() {
+    const int ret = do_register(IORING_REGISTER_ENABLE_RINGS, nullptr, 0);
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::enable_rings"
+        };
+    }
+    return ret;
+}
+
+/**
+ * @brief Signal `event_fd` when completions are posted to the CQ.
+ *
+ * @details This lets an external epoll loop sleep on `event_fd` and call
+ * `for_each_cqe` when it is readable. The eventfd counter is only a hint: it
+ * may count more or fewer than the posted cqes, so drain the CQ until it is
+ * empty.
+ *
+ * @param async_only only signal for requests completed asynchronously, i.e.
+ * not inline at submission (IORING_REGISTER_EVENTFD_ASYNC).
+ * @return 0 on success
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::register_eventfd(int event_fd, bool async_only) {
+    const int ret = do_register(
+        async_only ? IORING_REGISTER_EVENTFD_ASYNC : IORING_REGISTER_EVENTFD,
+        &event_fd, 1
+    );
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::register_eventfd"
+        };
+    }
+    return ret;
+}
+
+template<uint64_t uring_flags>
+int uring<uring_flags>::unregister_eventfd() {
+    const int ret = do_register(IORING_UNREGISTER_EVENTFD, nullptr, 0);
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::unregister_eventfd"
+        };
+    }
+    return ret;
+}
+
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 8)
+/**
+ * @brief Pause or resume the registered eventfd without unregistering it.
+ *
+ * @details It only sets IORING_CQ_EVENTFD_DISABLED in the CQ ring, so it is
+ * cheap enough to toggle around a busy-polling phase.
+ */
+template<uint64_t uring_flags>
+void uring<uring_flags>::set_cq_eventfd_enabled(bool enabled) {
+    if (cq.kflags == nullptr) [[unlikely]] {
+        throw std::system_error{
+            EOPNOTSUPP, std::system_category(), "uring::set_cq_eventfd_enabled"
+        };
+    }
+
+    const unsigned flags = IO_URING_READ_ONCE(*cq.kflags);
+    if (enabled) {
+        IO_URING_WRITE_ONCE(*cq.kflags, flags & ~IORING_CQ_EVENTFD_DISABLED);
+    } else {
+        IO_URING_WRITE_ONCE(*cq.kflags, flags | IORING_CQ_EVENTFD_DISABLED);
+    }
+}
+
+template<uint64_t uring_flags>
+inline bool uring<uring_flags>::is_cq_eventfd_enabled() const noexcept {
+    return cq.kflags == nullptr
+           || !(IO_URING_READ_ONCE(*cq.kflags) & IORING_CQ_EVENTFD_DISABLED);
+}
+#endif
+
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 15)
+/**
+ * @brief Confine the io-wq workers of this ring to the CPUs in `mask`.
+ *
+ * @return 0 on success
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::register_iowq_aff(const cpu_set_t &mask) {
+    const int ret = do_register(IORING_REGISTER_IOWQ_AFF, &mask, sizeof(mask));
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::register_iowq_aff"
+        };
+    }
+    return ret;
+}
+
+/**
+ * @brief Let the io-wq workers of this ring run on any CPU again.
+ *
+ * @return 0 on success
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::unregister_iowq_aff() {
+    const int ret = do_register(IORING_UNREGISTER_IOWQ_AFF, nullptr, 0);
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::unregister_iowq_aff"
+        };
+    }
+    return ret;
+}
+
+/**
+ * @brief Limit the number of io-wq workers of this ring.
+ *
+ * @details The limits are per NUMA node. A limit of 0 leaves it unchanged,
+ * so `register_iowq_max_workers({0, 0})` just queries the current limits.
+ *
+ * @return the limits before this call
+ */
+template<uint64_t uring_flags>
+iowq_max_workers
+uring<uring_flags>::register_iowq_max_workers(iowq_max_workers limits) {
+    unsigned values[2] = {limits.bounded, limits.unbounded};
+    const int ret = do_register(IORING_REGISTER_IOWQ_MAX_WORKERS, values, 2);
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{
+            -ret, std::system_category(), "uring::register_iowq_max_workers"
+        };
+    }
+    return {values[0], values[1]};
+}
+#endif
+
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 0)
+/**
+ * @brief Cancel in-flight requests synchronously.
+ *
+ * @details Unlike `sq_entry::prep_cancle`, no sqe or CQE is involved, so it
+ * works even if the SQ ring is full.
+ *
+ * Without IORING_ASYNC_CANCEL_ALL, the kernel waits for a matched request
+ * which is already running, so on 0 it has completed. With
+ * IORING_ASYNC_CANCEL_ALL, running requests are only signaled and counted in
+ * the result. Call it again until it returns 0 to be sure that none is left,
+ * as `sync_cancel_fd` and `sync_cancel_all` do.
+ *
+ * Either way, a CQE may be posted only when the task work of the submitting
+ * thread runs, e.g. by `get_events`.
+ *
+ * @param user_data the key to match, ignored with IORING_ASYNC_CANCEL_FD or
+ * IORING_ASYNC_CANCEL_ANY
+ * @param flags IORING_ASYNC_CANCEL_*
+ * @param timeout {-1, -1} means no timeout
+ * @return the number of matched requests with IORING_ASYNC_CANCEL_ALL,
+ * otherwise 0 on success. -ENOENT if nothing matches, -ETIME if timed out,
+ * or other negative errno.
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::sync_cancel(
+    uint64_t user_data, unsigned flags, const __kernel_timespec &timeout
+) noexcept {
+    const io_uring_sync_cancel_reg reg = {
+        .addr = user_data,
+        .fd = -1,
+        .flags = flags,
+        .timeout = timeout,
+        .pad = {},
+    };
+    return do_register(IORING_REGISTER_SYNC_CANCEL, &reg, 1);
+}
+
+/**
+ * @brief Cancel all in-flight requests of `fd`, and wait until they are all
+ * gone. See `sync_cancel`.
+ *
+ * @param is_fixed whether `fd` is an index of the registered files
+ * @param timeout {-1, -1} means no timeout. It applies to each retry.
+ * @return 0 once no request of `fd` is in flight, or negative errno
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::sync_cancel_fd(
+    int fd, bool is_fixed, const __kernel_timespec &timeout
+) noexcept {
+    const io_uring_sync_cancel_reg reg = {
+        .addr = 0,
+        .fd = fd,
+        .flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL
+                 | (is_fixed ? IORING_ASYNC_CANCEL_FD_FIXED : 0U),
+        .timeout = timeout,
+        .pad = {},
+    };
+    return sync_cancel_until_idle(reg);
+}
+
+/**
+ * @brief Cancel all in-flight requests of the ring, and wait until they are
+ * all gone. See `sync_cancel`.
+ *
+ * @param timeout {-1, -1} means no timeout. It applies to each retry.
+ * @return 0 once no request is in flight, or negative errno
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::sync_cancel_all(const __kernel_timespec &timeout
+) noexcept {
+    const io_uring_sync_cancel_reg reg = {
+        .addr = 0,
+        .fd = -1,
+        .flags = IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL,
+        .timeout = timeout,
+        .pad = {},
+    };
+    return sync_cancel_until_idle(reg);
+}
+
+/**
+ * @brief Repeat an IORING_ASYNC_CANCEL_ALL cancelation until nothing matches.
+ *
+ * @details The kernel counts running io-wq requests without waiting for them,
+ * so a positive result means some may still be in flight. A canceled request
+ * may also stay matchable until the task work completing it runs, which
+ * `get_events` does in between, e.g. for IORING_SETUP_DEFER_TASKRUN.
+ */
+template<uint64_t uring_flags>
+int uring<uring_flags>::sync_cancel_until_idle(
+    const io_uring_sync_cancel_reg &reg
+) noexcept {
+    int ret;
+    while ((ret = do_register(IORING_REGISTER_SYNC_CANCEL, &reg, 1)) > 0) {
+        get_events();
+    }
+    return ret == -ENOENT ? 0 : ret;
+}
+#endif
+
+/**
+ * @brief Allocate and register a ring of provided buffers.
+ *
+ * @param entries number of buffers in the ring. Must be pow of 2.
+ * @param bgid buffer group id, see `sq_entry::set_buffer_select`
+ * @return buf_ring& an empty buf_ring. Fill it by `buf_ring::add` and
+ * `buf_ring::advance`.
+ */
+template<uint64_t uring_flags>
+buf_ring &uring<uring_flags>::setup_buf_ring(unsigned entries, uint16_t bgid) {
+    const size_t size = entries * sizeof(io_uring_buf);
+    void *const ptr = __sys_mmap(
+        nullptr, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE,
+        -1, 0
+    );
+    if (IS_ERR(ptr)) [[unlikely]] {
+        throw std::system_error{
+            -PTR_ERR(ptr), std::system_category(), "uring::setup_buf_ring mmap"
+        };
+    }
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ptr);
+    reg.ring_entries = entries;
+    reg.bgid = bgid;
+
+    const int ret = do_register(IORING_REGISTER_PBUF_RING, &reg, 1);
+    if (ret < 0) [[unlikely]] {
+        __sys_munmap(ptr, size);
+        throw std::system_error{
+            -ret, std::system_category(), "uring::setup_buf_ring"
+        };
+    }
+
+    buf_ring &br = *static_cast<buf_ring *>(ptr);
+    br.init();
+    return br;
+}
+
+/**
+ * @brief Unregister and release a buf_ring from `setup_buf_ring`.
+ */
+template<uint64_t uring_flags>
+void uring<uring_flags>::free_buf_ring(
+    buf_ring &br, unsigned entries, uint16_t bgid
+) noexcept {
+    io_uring_buf_reg reg{};
+    reg.bgid = bgid;
+    do_register(IORING_UNREGISTER_PBUF_RING, &reg, 1);
+    __sys_munmap(&br, entries * sizeof(io_uring_buf));
+}
+
 template<uint64_t uring_flags>
 void uring<uring_flags>::init(unsigned entries, params &params) {
-    assert(this->ring_fd == -1 && "The uring may be inited twice.");
+    assert(this->enter_ring_fd == -1 && "The uring may be inited twice.");
+    static_assert(
+        !(uring_flags & IORING_SETUP_REGISTERED_FD_ONLY)
+            || (uring_flags & IORING_SETUP_NO_MMAP),
+        "IORING_SETUP_REGISTERED_FD_ONLY requires IORING_SETUP_NO_MMAP."
+    );
+
+    // override the params.flags, except the runtime ones
+    params.flags = static_cast<uint32_t>(uring_flags)
+                   | (params.flags & uring_params::runtime_flags);
 
-    // override the params.flags
-    params.flags = static_cast<uint32_t>(uring_flags);
+    size_t app_mem_size = 0;
+    if constexpr (uring_flags & IORING_SETUP_NO_MMAP) {
+        app_mem_size = alloc_app_mem(entries, params);
+    }
+    auto *const app_mem = reinterpret_cast<void *>(params.sq_off.user_addr);
 
     const int fd = __sys_io_uring_setup(entries, &params);
     if (fd < 0) [[unlikely]] {
+        if constexpr (uring_flags & IORING_SETUP_NO_MMAP) {
+            __sys_munmap(app_mem, app_mem_size);
+        }
         throw std::system_error{
             -fd, std::system_category(), "uring()::__sys_io_uring_setup"
         };
@@ -607,19 +1432,116 @@ void uring<uring_flags>::init(unsigned entries, params &params) {
 
     std::memset(this, 0, sizeof(*this)); // NOLINT
 
-    this->ring_fd = this->enter_ring_fd = fd;
+    if constexpr (uring_flags & IORING_SETUP_REGISTERED_FD_ONLY) {
+        // `fd` is the index of the registered ring fd, no real fd is held
+        this->ring_fd = -1;
+        this->enter_ring_fd = fd;
+        this->int_flags = INT_FLAG_REG_RING | INT_FLAG_REG_REG_RING;
+        this->reg_tid = ::gettid();
+    } else {
+        this->ring_fd = this->enter_ring_fd = fd;
+        this->int_flags = 0;
+    }
     this->features = params.features;
-    this->int_flags = 0;
-    try {
-        mmap_queue(fd, params);
+
+    if constexpr (uring_flags & IORING_SETUP_NO_MMAP) {
+        this->int_flags |= INT_FLAG_APP_MEM;
+        attach_rings(
+            params, reinterpret_cast<void *>(params.cq_off.user_addr),
+            reinterpret_cast<void *>(params.cq_off.user_addr),
+            static_cast<sq_entry *>(app_mem)
+        );
+        // the whole app memory, see `alloc_app_mem`
+        sq.ring_sz = app_mem_size;
         this->sq.init_free_queue();
-        if constexpr (config::using_register_ring_fd) {
-            register_ring_fd();
+    }
+
+    if constexpr (!(uring_flags & IORING_SETUP_REGISTERED_FD_ONLY)) {
+        try {
+            if constexpr (!(uring_flags & IORING_SETUP_NO_MMAP)) {
+                mmap_queue(fd, params);
+                this->sq.init_free_queue();
+            }
+            if constexpr (config::using_register_ring_fd) {
+                register_ring_fd();
+            }
+        } catch (...) {
+            if constexpr (uring_flags & IORING_SETUP_NO_MMAP) {
+                __sys_munmap(app_mem, app_mem_size);
+            }
+            __sys_close(fd);
+            std::rethrow_exception(std::current_exception());
+        }
+    }
+}
+
+/**
+ * @brief Allocate the memory of sqes and rings for IORING_SETUP_NO_MMAP,
+ * and fill `p.sq_off.user_addr` and `p.cq_off.user_addr`.
+ *
+ * @details sqes come first, followed by the rings at the next page. The
+ * kernel wants each of them physically contiguous before 6.14, so a huge page
+ * is tried when they do not fit in one page.
+ *
+ * @return size of the memory
+ */
+template<uint64_t uring_flags>
+size_t uring<uring_flags>::alloc_app_mem(unsigned entries, params &p) {
+    constexpr int sqe_shift = bool(uring_flags & IORING_SETUP_SQE128) ? 1 : 0;
+    constexpr int cqe_shift = bool(uring_flags & IORING_SETUP_CQE32) ? 1 : 0;
+    // IORING_MAX_ENTRIES of the kernel
+    constexpr unsigned max_sq_entries = 32768;
+    // more than sizeof(struct io_rings) of any kernel
+    constexpr size_t rings_header_size = 512;
+    constexpr size_t huge_page_size = 2UL << 20;
+
+    unsigned sq_entries = std::bit_ceil(entries);
+    unsigned cq_entries =
+        (p.flags & IORING_SETUP_CQSIZE) ? std::bit_ceil(p.cq_entries)
+                                        : sq_entries * 2;
+    if (p.flags & IORING_SETUP_CLAMP) {
+        sq_entries = std::min(sq_entries, max_sq_entries);
+        cq_entries = std::min(cq_entries, uring_params::max_cq_entries);
+    }
+
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const auto page_align = [page_size](size_t size) {
+        return (size + page_size - 1) & ~(page_size - 1);
+    };
+    const size_t sqes_size =
+        page_align((sq_entries * sizeof(io_uring_sqe)) << sqe_shift);
+    // laid out as rings_size() of the kernel
+    size_t rings_size = rings_header_size + cq_entries * sizeof(io_uring_cqe);
+    rings_size = ((rings_size << cqe_shift) + 63) & ~size_t{63};
+    rings_size = page_align(rings_size + sq_entries * sizeof(unsigned));
+
+    size_t size = sqes_size + rings_size;
+    void *mem = ERR_PTR(-ENOMEM);
+    if (size > page_size && size <= huge_page_size) {
+        mem = __sys_mmap(
+            nullptr, huge_page_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0
+        );
+        if (!IS_ERR(mem)) {
+            size = huge_page_size;
         }
-    } catch (...) {
-        __sys_close(fd);
-        std::rethrow_exception(std::current_exception());
     }
+    if (IS_ERR(mem)) {
+        // enough for 6.14+, which does not need them contiguous
+        mem = __sys_mmap(
+            nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS | MAP_POPULATE, -1, 0
+        );
+        if (IS_ERR(mem)) [[unlikely]] {
+            throw std::system_error{
+                -PTR_ERR(mem), std::system_category(), "uring::alloc_app_mem"
+            };
+        }
+    }
+
+    p.sq_off.user_addr = reinterpret_cast<uint64_t>(mem);
+    p.cq_off.user_addr = reinterpret_cast<uint64_t>(mem) + sqes_size;
+    return size;
 }
 
 template<uint64_t uring_flags>
@@ -632,14 +1554,185 @@ void uring<uring_flags>::init(unsigned entries) {
     init(entries, params{static_cast<uint32_t>(uring_flags)});
 }
 
+/**
+ * @brief Change the size of the SQ and CQ rings of a live ring in place, by
+ * IORING_REGISTER_RESIZE_RINGS (since 6.13).
+ *
+ * @details In-flight requests, registrations and unreaped cqes are all kept.
+ * No sqe may be held unsubmitted, and pointers to cqes are invalidated.
+ *
+ * @param sq_entries the size of the new SQ ring. Must be pow of 2.
+ * @param cq_entries the size of the new CQ ring, 0 for twice `sq_entries`
+ * @throw std::system_error with EINVAL if the kernel lacks it, then
+ * `migrate` may be used instead. If the kernel has resized the rings but
+ * mapping the new ones fails, the old ones are gone already, so the ring is
+ * closed and `fd()` becomes -1. It may only be inited again or destroyed.
+ */
+template<uint64_t uring_flags>
+void uring<uring_flags>::resize(unsigned sq_entries, unsigned cq_entries)
+    requires(
+        bool(uring_flags & IORING_SETUP_DEFER_TASKRUN)
+        && !(uring_flags & IORING_SETUP_NO_MMAP)
+    )
+{
+    assert(sq.sqe_head == sq.sqe_tail && "unsubmitted sqes are left");
+    if constexpr (uring_flags & uring_setup::sqe_reorder) {
+        assert(sq.sqe_free_head == sq.sqe_tail && "unsubmitted sqes are left");
+        // the kernel copies pending sqes by slot, ignoring the SQ array
+        assert(sq_pending() == 0 && "submitted sqes are not consumed yet");
+    }
+
+    params p{0};
+    p.sq_entries = sq_entries;
+    if (cq_entries != 0) {
+        p.flags |= IORING_SETUP_CQSIZE;
+        p.cq_entries = cq_entries;
+    }
+
+    const int ret = do_register(detail::IORING_REGISTER_RESIZE_RINGS, &p, 1);
+    if (ret < 0) [[unlikely]] {
+        throw std::system_error{-ret, std::system_category(), "uring::resize"};
+    }
+
+    // The kernel has moved everything into new rings, with the same head and
+    // tail. Map them and drop the old ones.
+    constexpr int sqe_shift = bool(uring_flags & IORING_SETUP_SQE128) ? 1 : 0;
+    const submission_queue old_sq = sq;
+    const completion_queue old_cq = cq;
+    p.features = features;
+    if (p.sq_off.array == 0) {
+        // Not reported back by the kernel. Lay it out as rings_size() of the
+        // kernel: after the cqes, where the whole size is doubled for CQE32,
+        // aligned to a cacheline.
+        constexpr int cqe_shift =
+            bool(uring_flags & IORING_SETUP_CQE32) ? 1 : 0;
+        const size_t off =
+            (p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe)) << cqe_shift;
+        p.sq_off.array = static_cast<uint32_t>((off + 63) & ~63UL);
+    }
+    try {
+        mmap_queue(ring_fd, p);
+    } catch (...) {
+        // nothing to roll back to, the old rings are detached by the kernel
+        sq = old_sq;
+        cq = old_cq;
+        close_ring();
+        reset_state();
+        throw;
+    }
+    sq.init_free_queue();
+
+    __sys_munmap(
+        old_sq.sqes, (old_sq.ring_entries * sizeof(io_uring_sqe)) << sqe_shift
+    );
+    __sys_munmap(old_sq.ring_ptr, old_sq.ring_sz);
+    if (old_cq.ring_ptr && old_cq.ring_ptr != old_sq.ring_ptr) {
+        __sys_munmap(old_cq.ring_ptr, old_cq.ring_sz);
+    }
+}
+
+/**
+ * @brief Replace the ring with a fresh one of the new size, and close the old
+ * one.
+ *
+ * @details Unlike `resize`, nothing but `uring_flags` carries over:
+ * registrations, buffer rings, runtime params and unreaped cqes are lost, and
+ * in-flight requests of the old ring are cancelled. Only call it when the
+ * ring is idle and all of that can be set up again.
+ *
+ * @param sq_entries the size of the new SQ ring. Must be pow of 2.
+ * @param cq_entries the size of the new CQ ring, 0 for twice `sq_entries`
+ */
+template<uint64_t uring_flags>
+void uring<uring_flags>::migrate(unsigned sq_entries, unsigned cq_entries) {
+    assert(sq.sqe_head == sq.sqe_tail && "unsubmitted sqes are left");
+
+    params p{0};
+    if (cq_entries != 0) {
+        p.set_cq_entries(cq_entries);
+    }
+
+    // the old ring is closed with `fresh`
+    uring fresh;
+    fresh.init(sq_entries, p);
+    std::swap(sq, fresh.sq);
+    std::swap(cq, fresh.cq);
+    std::swap(ring_fd, fresh.ring_fd);
+    std::swap(features, fresh.features);
+    std::swap(enter_ring_fd, fresh.enter_ring_fd);
+    std::swap(int_flags, fresh.int_flags);
+    std::swap(reg_tid, fresh.reg_tid);
+}
+
 template<uint64_t uring_flags>
 uring<uring_flags>::~uring() noexcept {
-    if (this->ring_fd == -1) {
+    close_ring();
+}
+
+/**
+ * @brief Unregister, unmap and close the ring. The state is left as it is.
+ */
+template<uint64_t uring_flags>
+void uring<uring_flags>::close_ring() noexcept {
+    if (this->enter_ring_fd == -1) {
         return;
     }
-    __sys_munmap(sq.sqes, sq.ring_entries * sizeof(io_uring_sqe));
-    unmap_rings();
-    __sys_close(ring_fd);
+    /*
+     * The registered ring fd holds a reference to the ring, and there are
+     * only a few slots per task. Release it before closing. It is the last
+     * reference with IORING_SETUP_REGISTERED_FD_ONLY.
+     *
+     * The slots are per task, so on another thread the same index may be
+     * another ring. Leave the slot then, it is released when the registering
+     * thread exits.
+     */
+    if (this->int_flags & INT_FLAG_REG_RING) {
+        assert(
+            (!(uring_flags & IORING_SETUP_REGISTERED_FD_ONLY)
+             || this->reg_tid == ::gettid())
+            && "The ring must be destroyed on the thread which inited it."
+        );
+        if (this->reg_tid == ::gettid()) {
+            io_uring_rsrc_update up = {
+                .offset = unsigned(this->enter_ring_fd),
+                .resv = 0,
+                .data = 0,
+            };
+            do_register(IORING_UNREGISTER_RING_FDS, &up, 1);
+        }
+    }
+    if constexpr (uring_flags & IORING_SETUP_NO_MMAP) {
+        __sys_munmap(sq.sqes, sq.ring_sz);
+    } else {
+        constexpr int sqe_shift =
+            bool(uring_flags & IORING_SETUP_SQE128) ? 1 : 0;
+        __sys_munmap(
+            sq.sqes, (sq.ring_entries * sizeof(io_uring_sqe)) << sqe_shift
+        );
+        unmap_rings();
+    }
+    if (ring_fd != -1) {
+        __sys_close(ring_fd);
+    }
+}
+
+/**
+ * @brief Call io_uring_register on this ring.
+ *
+ * @return the result of the syscall, -errno on failure
+ */
+template<uint64_t uring_flags>
+inline int uring<uring_flags>::do_register(
+    unsigned opcode, const void *arg, unsigned nr_args
+) const noexcept {
+    if constexpr (uring_flags & IORING_SETUP_REGISTERED_FD_ONLY) {
+        return __sys_io_uring_register(
+            this->enter_ring_fd, opcode | IORING_REGISTER_USE_REGISTERED_RING,
+            arg, nr_args
+        );
+    } else {
+        return __sys_io_uring_register(this->ring_fd, opcode, arg, nr_args);
+    }
 }
 
 /**
@@ -681,54 +1774,77 @@ int uring<uring_flags>::__submit(
  */
 template<uint64_t uring_flags>
 void uring<uring_flags>::mmap_queue(int fd, params &p) {
+    constexpr int sqe_shift = bool(uring_flags & IORING_SETUP_SQE128) ? 1 : 0;
+    constexpr int cqe_shift = bool(uring_flags & IORING_SETUP_CQE32) ? 1 : 0;
+
     sq.ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
-    cq.ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    cq.ring_sz =
+        p.cq_off.cqes + ((p.cq_entries * sizeof(io_uring_cqe)) << cqe_shift);
 
     if (p.features & IORING_FEAT_SINGLE_MMAP) {
         sq.ring_sz = cq.ring_sz = std::max(sq.ring_sz, cq.ring_sz);
     }
 
-    sq.ring_ptr = __sys_mmap(
+    // __sys_mmap returns -errno as a pointer, not MAP_FAILED
+    void *const sq_ring = __sys_mmap(
         nullptr, sq.ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
         fd, IORING_OFF_SQ_RING
     );
-    if (sq.ring_ptr == MAP_FAILED) /*NOLINT*/ [[unlikely]] {
+    if (IS_ERR(sq_ring)) [[unlikely]] {
         throw std::system_error{
-            errno, std::system_category(), "sq.ring MAP_FAILED"
+            -PTR_ERR(sq_ring), std::system_category(), "sq.ring MAP_FAILED"
         };
     }
+    sq.ring_ptr = sq_ring;
 
     if (p.features & IORING_FEAT_SINGLE_MMAP) {
         cq.ring_ptr = sq.ring_ptr;
     } else {
-        cq.ring_ptr = __sys_mmap(
+        void *const cq_ring = __sys_mmap(
             nullptr, cq.ring_sz, PROT_READ | PROT_WRITE,
             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING
         );
-        if (cq.ring_ptr == MAP_FAILED) /*NOLINT*/ [[unlikely]] {
+        if (IS_ERR(cq_ring)) [[unlikely]] {
             // don't forget to clean up sq
             cq.ring_ptr = nullptr;
             unmap_rings();
             throw std::system_error{
-                errno, std::system_category(), "cq.ring MAP_FAILED"
+                -PTR_ERR(cq_ring), std::system_category(), "cq.ring MAP_FAILED"
             };
         }
+        cq.ring_ptr = cq_ring;
     }
 
-    sq.set_offset(p.sq_off);
-
-    const size_t sqes_size = p.sq_entries * sizeof(io_uring_sqe);
-    sq.sqes = reinterpret_cast<sq_entry *>(__sys_mmap(
+    const size_t sqes_size = (p.sq_entries * sizeof(io_uring_sqe)) << sqe_shift;
+    void *const sqes = __sys_mmap(
         nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
         fd, IORING_OFF_SQES
-    ));
-    if (sq.sqes == MAP_FAILED) /*NOLINT*/ [[unlikely]] {
+    );
+    if (IS_ERR(sqes)) [[unlikely]] {
         unmap_rings();
         throw std::system_error{
-            errno, std::system_category(), "sq.sqes MAP_FAILED"
+            -PTR_ERR(sqes), std::system_category(), "sq.sqes MAP_FAILED"
         };
     }
 
+    attach_rings(
+        p, sq.ring_ptr, cq.ring_ptr, reinterpret_cast<sq_entry *>(sqes)
+    );
+}
+
+/**
+ * @brief Point SQ and CQ to rings which are already in user space.
+ *
+ * @param p params filled by the kernel, describing the shape of ring
+ */
+template<uint64_t uring_flags>
+inline void uring<uring_flags>::attach_rings(
+    const params &p, void *sq_ring_ptr, void *cq_ring_ptr, sq_entry *sqes
+) noexcept {
+    sq.ring_ptr = sq_ring_ptr;
+    cq.ring_ptr = cq_ring_ptr;
+    sq.sqes = sqes;
+    sq.set_offset(p.sq_off);
     cq.set_offset(p.cq_off);
 }
 
@@ -6,7 +6,23 @@ namespace liburingcxx {
 
 enum uring_setup : uint64_t {
     // from (1ULL << 32) to (1ULL << 63)
-    sqe_reorder = 1ULL << 32
+    sqe_reorder = 1ULL << 32,
+    /*
+     * Keep the state written by the submitting thread, the CQ state and the
+     * rest of `uring` on separate cache lines, so that a reaping thread does
+     * not bounce the line of the submitting thread.
+     */
+    cacheline_separated = 1ULL << 33,
 };
 
+/**
+ * @brief The bit of `user_data` reserved for fire-and-forget sqes.
+ *
+ * @details See `sq_entry::set_fire_and_forget()`. Other `user_data` must keep
+ * this bit clear to be told apart by `uring::for_each_cqe(f, on_failure)`.
+ * `user_data_schema` and userspace pointers do, sentinels like `-1ULL` do
+ * not.
+ */
+inline constexpr uint64_t fire_and_forget_flag = 1ULL << 63;
+
 } // namespace liburingcxx
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <uring/utility/user_data.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace liburingcxx {
+
+/**
+ * @brief A fixed-size slab of contexts for in-flight operations.
+ *
+ * @details All slots live in one contiguous allocation made at construction,
+ * so `emplace` and `erase` never touch the heap. A live context is addressed
+ * by a `user_data` holding its slot index and the generation of the slot, laid
+ * out by `Schema`. The generation changes whenever the slot is erased, so a
+ * CQE carrying a stale `user_data` is rejected by `find` instead of aliasing a
+ * newer context.
+ *
+ * Not thread-safe, it is meant to be owned by the thread reaping the ring.
+ *
+ * @tparam T type of the per-operation context
+ * @tparam Schema a `user_data_schema`, whose tag may carry the op kind
+ */
+template<typename T, typename Schema = default_user_data_schema>
+class context_pool final {
+  public:
+    /**
+     * @param capacity the max number of live contexts, at least 1
+     */
+    explicit context_pool(uint32_t capacity)
+        // the storage is left uninitialized, as `emplace` constructs in it
+        : slots(std::make_unique_for_overwrite<slot[]>(capacity))
+        , capacity_num(capacity) {
+        assert(capacity != 0 && "capacity must not be 0");
+        assert(
+            capacity - 1 <= Schema::index_mask
+            && "capacity exceeds the index field of Schema"
+        );
+        for (uint32_t i = 0; i < capacity; ++i) {
+            slots[i].next_free = i + 1;
+        }
+    }
+
+    ~context_pool() noexcept {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            for (uint32_t i = 0; i < capacity_num && live_num != 0; ++i) {
+                if (slots[i].is_live()) {
+                    slots[i].get()->~T();
+                    --live_num;
+                }
+            }
+        }
+    }
+
+    context_pool(const context_pool &) = delete;
+    context_pool &operator=(const context_pool &) = delete;
+
+    /**
+     * @brief Construct a context in a free slot.
+     *
+     * @details Without `args` the context is default-initialized, not
+     * value-initialized, so e.g. a large buffer member is not zero-filled.
+     *
+     * @return nullptr if the pool is exhausted
+     */
+    template<typename... Args>
+    [[nodiscard]]
+    T *emplace(Args &&...args) noexcept(
+        std::is_nothrow_constructible_v<T, Args...>
+    ) {
+        if (free_head == capacity_num) [[unlikely]] {
+            return nullptr;
+        }
+        slot &s = slots[free_head];
+        T *ctx;
+        if constexpr (sizeof...(Args) == 0) {
+            ctx = ::new (static_cast<void *>(s.storage)) T;
+        } else {
+            ctx = ::new (static_cast<void *>(s.storage))
+                T(std::forward<Args>(args)...);
+        }
+        free_head = s.next_free;
+        ++s.generation; // becomes odd, i.e. live
+        ++live_num;
+        return ctx;
+    }
+
+    /**
+     * @brief Destroy a live context and release its slot.
+     */
+    void erase(T *ctx) noexcept {
+        slot &s = slot_of(ctx);
+        assert(s.is_live() && "The context is erased twice.");
+        ctx->~T();
+        ++s.generation; // becomes even, stale user_data is rejected
+        s.next_free = free_head;
+        free_head = static_cast<uint32_t>(&s - slots.get());
+        --live_num;
+    }
+
+    /**
+     * @brief The `user_data` to be set to the SQE of a live context.
+     *
+     * @param tag the op kind, which can be read by `Schema::tag` later
+     */
+    [[nodiscard]]
+    uint64_t user_data(
+        const T *ctx, typename Schema::tag_type tag = {}
+    ) const noexcept {
+        const slot &s = slot_of(ctx);
+        assert(s.is_live());
+        return Schema::encode(
+            tag, static_cast<uint32_t>(&s - slots.get()), s.generation
+        );
+    }
+
+    /**
+     * @brief Map the `user_data` of a CQE back to its context.
+     *
+     * @return nullptr if `user_data` is stale or not made by this pool
+     */
+    [[nodiscard]]
+    T *find(uint64_t user_data) const noexcept {
+        const uint32_t index = Schema::index(user_data);
+        if (index >= capacity_num) [[unlikely]] {
+            return nullptr;
+        }
+        slot &s = slots[index];
+        if (!s.is_live() || !Schema::match_generation(user_data, s.generation))
+            [[unlikely]] {
+            return nullptr;
+        }
+        return s.get();
+    }
+
+    [[nodiscard]]
+    uint32_t size() const noexcept {
+        return live_num;
+    }
+
+    [[nodiscard]]
+    uint32_t capacity() const noexcept {
+        return capacity_num;
+    }
+
+    [[nodiscard]]
+    bool full() const noexcept {
+        return free_head == capacity_num;
+    }
+
+  private:
+    struct slot {
+        // the context must be the first member, see `slot_of`
+        alignas(T) std::byte storage[sizeof(T)];
+        // odd means live
+        uint32_t generation = 0;
+        uint32_t next_free;
+
+        bool is_live() const noexcept { return generation & 1U; }
+
+        T *get() noexcept {
+            return std::launder(reinterpret_cast<T *>(storage));
+        }
+    };
+
+    std::unique_ptr<slot[]> slots;
+    const uint32_t capacity_num;
+    uint32_t free_head = 0;
+    uint32_t live_num = 0;
+
+    slot &slot_of(const T *ctx) const noexcept {
+        auto *const s = reinterpret_cast<slot *>(
+            const_cast<std::byte *>(reinterpret_cast<const std::byte *>(ctx))
+        );
+        assert(s >= slots.get() && s < slots.get() + capacity_num);
+        return *s;
+    }
+};
+
+} // namespace liburingcxx
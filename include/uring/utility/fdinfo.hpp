@@ -0,0 +1,211 @@
+#pragma once
+
+#include <uring/compat.hpp>
+#include <uring/io_uring.h>
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <system_error>
+#include <vector>
+
+namespace liburingcxx {
+
+template<uint64_t uring_flags>
+class uring;
+
+/**
+ * @brief Snapshot of `/proc/<pid>/fdinfo/<ring_fd>` of an io_uring instance.
+ *
+ * @details Fields which are not reported by the running kernel keep their
+ * default value. `sq_total_time` and `sq_work_time` are in microseconds and
+ * are reported since Linux 6.8.
+ */
+struct ring_fdinfo {
+    struct overflow_entry {
+        uint64_t user_data;
+        int32_t res;
+        uint32_t flags;
+    };
+
+    unsigned sq_mask = 0;
+    unsigned sq_head = 0;
+    unsigned sq_tail = 0;
+    unsigned cached_sq_head = 0;
+    unsigned cq_mask = 0;
+    unsigned cq_head = 0;
+    unsigned cq_tail = 0;
+    unsigned cached_cq_tail = 0;
+
+    // number of SQEs not consumed by kernel
+    unsigned sq_pending = 0;
+    // number of CQEs not reaped by application
+    unsigned cq_pending = 0;
+
+    // pid of the SQPOLL kernel thread, -1 if there is none
+    int sq_thread = -1;
+    int sq_thread_cpu = -1;
+    uint64_t sq_total_time = 0;
+    uint64_t sq_work_time = 0;
+
+    unsigned user_files = 0;
+    unsigned user_bufs = 0;
+    unsigned poll_list = 0;
+    std::vector<overflow_entry> cq_overflow_list;
+
+    /**
+     * @brief Parse the fdinfo of an io_uring fd.
+     *
+     * @param fd the ring fd in the process `pid`
+     * @param pid 0 means the calling process
+     * @throw std::system_error if the fdinfo file can not be opened
+     */
+    [[nodiscard]]
+    static ring_fdinfo read(int fd, pid_t pid = 0);
+
+    /**
+     * @brief Parse fdinfo text from `file` until EOF, e.g. a copy saved
+     * elsewhere and opened by `fmemopen`.
+     */
+    [[nodiscard]]
+    static ring_fdinfo parse(std::FILE *file);
+
+    /**
+     * @throw std::system_error with EBADF if `ring` is not inited
+     */
+    template<uint64_t uring_flags>
+    [[nodiscard]]
+    static ring_fdinfo read(const uring<uring_flags> &ring) {
+        static_assert(
+            !(uring_flags & IORING_SETUP_REGISTERED_FD_ONLY),
+            "A ring with IORING_SETUP_REGISTERED_FD_ONLY has no fd, so it has "
+            "no fdinfo either."
+        );
+        if (ring.fd() < 0) [[unlikely]] {
+            throw std::system_error{
+                EBADF, std::system_category(), "ring_fdinfo::read"
+            };
+        }
+        return read(ring.fd());
+    }
+
+  private:
+    enum class section : uint8_t { none, poll_list, cq_overflow_list };
+
+    void parse_line(const char *line, section &sec) noexcept;
+};
+
+inline ring_fdinfo ring_fdinfo::read(int fd, pid_t pid) {
+    const std::string path =
+        (pid == 0 ? std::string{"/proc/self"}
+                  : "/proc/" + std::to_string(pid))
+        + "/fdinfo/" + std::to_string(fd);
+
+    std::FILE *const file = std::fopen(path.c_str(), "re");
+    if (file == nullptr) [[unlikely]] {
+        throw std::system_error{
+            errno, std::system_category(), "ring_fdinfo::read " + path
+        };
+    }
+
+    ring_fdinfo info = parse(file);
+    std::fclose(file);
+    return info;
+}
+
+inline ring_fdinfo ring_fdinfo::parse(std::FILE *file) {
+    // lines like UserFiles may be long, read each of them whole
+    ring_fdinfo info;
+    section sec = section::none;
+    char *line = nullptr;
+    size_t capacity = 0;
+    while (::getline(&line, &capacity, file) != -1) {
+        info.parse_line(line, sec);
+    }
+    std::free(line); // NOLINT
+    return info;
+}
+
+inline void ring_fdinfo::parse_line(const char *line, section &sec) noexcept {
+    // NOLINTBEGIN(cert-err34-c)
+    if (line[0] == ' ' || line[0] == '\t') {
+        // indented lines are entries of the last list section
+        if (sec == section::poll_list) {
+            ++poll_list;
+        } else if (sec == section::cq_overflow_list) {
+            overflow_entry e{};
+            if (std::sscanf(
+                    line, " user_data=%" SCNu64 ", res=%" SCNd32
+                          ", flags=%" SCNx32,
+                    &e.user_data, &e.res, &e.flags
+                )
+                == 3) {
+                cq_overflow_list.push_back(e);
+            }
+        }
+        return;
+    }
+
+    sec = section::none;
+
+    const char *const colon = std::strchr(line, ':');
+    if (colon == nullptr) {
+        return;
+    }
+    const std::string_view key{line, size_t(colon - line)};
+    const char *const value = colon + 1;
+
+    const auto as_unsigned = [value](unsigned &out) noexcept {
+        std::sscanf(value, " %u", &out);
+    };
+    const auto as_hex = [value](unsigned &out) noexcept {
+        std::sscanf(value, " %x", &out);
+    };
+
+    if (key == "SqMask") {
+        as_hex(sq_mask);
+    } else if (key == "SqHead") {
+        as_unsigned(sq_head);
+    } else if (key == "SqTail") {
+        as_unsigned(sq_tail);
+    } else if (key == "CachedSqHead") {
+        as_unsigned(cached_sq_head);
+    } else if (key == "CqMask") {
+        as_hex(cq_mask);
+    } else if (key == "CqHead") {
+        as_unsigned(cq_head);
+    } else if (key == "CqTail") {
+        as_unsigned(cq_tail);
+    } else if (key == "CachedCqTail") {
+        as_unsigned(cached_cq_tail);
+    } else if (key == "SQEs") {
+        as_unsigned(sq_pending);
+    } else if (key == "CQEs") {
+        as_unsigned(cq_pending);
+    } else if (key == "SqThread") {
+        std::sscanf(value, " %d", &sq_thread);
+    } else if (key == "SqThreadCpu") {
+        std::sscanf(value, " %d", &sq_thread_cpu);
+    } else if (key == "SqTotalTime") {
+        std::sscanf(value, " %" SCNu64, &sq_total_time);
+    } else if (key == "SqWorkTime") {
+        std::sscanf(value, " %" SCNu64, &sq_work_time);
+    } else if (key == "UserFiles") {
+        as_unsigned(user_files);
+    } else if (key == "UserBufs") {
+        as_unsigned(user_bufs);
+    } else if (key == "PollList") {
+        sec = section::poll_list;
+    } else if (key == "CqOverflowList") {
+        sec = section::cq_overflow_list;
+    }
+    // NOLINTEND(cert-err34-c)
+}
+
+} // namespace liburingcxx
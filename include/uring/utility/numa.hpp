@@ -0,0 +1,265 @@
+#pragma once
+
+#include <uring/uring.hpp>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <string>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace liburingcxx {
+
+/**
+ * @brief Place a ring, its memory and its kernel threads on one NUMA node.
+ *
+ * @details The kernel allocates the rings of `io_uring_setup` by the memory
+ * policy of the calling thread, and the memory of IORING_SETUP_NO_MMAP or of a
+ * buffer ring is faulted in by the thread which sets it up. So `init_ring` and
+ * `setup_buf_ring` run inside a `scope`, which prefers the node for memory
+ * and pins the thread to the CPUs of the node. Then the SQPOLL thread and
+ * io-wq workers are pinned to the node as well.
+ *
+ * Memory allocated elsewhere, e.g. buffers to be registered, can be moved by
+ * `bind`. It must be done before registering, since the kernel pins
+ * registered pages where they are.
+ *
+ * ```
+ * const auto node = numa_node::current();
+ * uring<0> ring;
+ * node.init_ring(ring, 256);
+ * buf_ring &br = node.setup_buf_ring(ring, 64, bgid);
+ * node.bind(buffers, buffers_size);
+ * ring.register_buffers(iovecs);
+ * ```
+ *
+ * Needs no libnuma, only the syscalls and sysfs.
+ */
+class numa_node final {
+    // bits of the node masks passed to the kernel
+    static constexpr unsigned max_nodes = 1024;
+    static constexpr unsigned mask_words = max_nodes / (8 * sizeof(long));
+
+  public:
+    /**
+     * @throw std::system_error if the node does not exist
+     */
+    explicit numa_node(int node)
+        : node(node) {
+        read_cpus();
+    }
+
+    /**
+     * @brief The node of the CPU running the calling thread.
+     */
+    [[nodiscard]]
+    static numa_node current() {
+        unsigned cpu = 0;
+        unsigned node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) < 0) [[unlikely]] {
+            throw std::system_error{
+                errno, std::system_category(), "numa_node::current"
+            };
+        }
+        return numa_node{static_cast<int>(node)};
+    }
+
+    [[nodiscard]]
+    int id() const noexcept {
+        return node;
+    }
+
+    /**
+     * @brief CPUs of the node, e.g. for `uring::register_iowq_aff`.
+     */
+    [[nodiscard]]
+    const cpu_set_t &cpus() const noexcept {
+        return cpu_set;
+    }
+
+    [[nodiscard]]
+    unsigned first_cpu() const noexcept {
+        return first;
+    }
+
+    /**
+     * @brief Move the pages of `[addr, addr + len)` to the node, and keep
+     * them there. `addr` must be page aligned.
+     */
+    void bind(void *addr, size_t len) const {
+        unsigned long mask[mask_words] = {};
+        set_bit(mask);
+        if (syscall(
+                SYS_mbind, addr, len, MPOL_BIND, mask, max_nodes + 1,
+                MPOL_MF_MOVE
+            )
+            < 0) [[unlikely]] {
+            throw std::system_error{
+                errno, std::system_category(), "numa_node::bind"
+            };
+        }
+    }
+
+    /**
+     * @brief Pin the calling thread to the node and prefer its memory, until
+     * the end of the scope.
+     */
+    class scope final {
+      public:
+        explicit scope(const numa_node &n) {
+            if (sched_getaffinity(0, sizeof(old_cpus), &old_cpus) < 0)
+                [[unlikely]] {
+                throw std::system_error{
+                    errno, std::system_category(), "numa_node::scope"
+                };
+            }
+            if (syscall(
+                    SYS_get_mempolicy, &old_mode, old_mask, max_nodes + 1,
+                    nullptr, 0
+                )
+                < 0) [[unlikely]] {
+                throw std::system_error{
+                    errno, std::system_category(), "numa_node::scope"
+                };
+            }
+
+            unsigned long mask[mask_words] = {};
+            n.set_bit(mask);
+            if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, max_nodes + 1)
+                < 0) [[unlikely]] {
+                throw std::system_error{
+                    errno, std::system_category(), "numa_node::scope"
+                };
+            }
+            if (sched_setaffinity(0, sizeof(n.cpu_set), &n.cpu_set) < 0)
+                [[unlikely]] {
+                const int err = errno;
+                restore_mempolicy();
+                throw std::system_error{
+                    err, std::system_category(), "numa_node::scope"
+                };
+            }
+        }
+
+        scope(const scope &) = delete;
+        scope &operator=(const scope &) = delete;
+
+        ~scope() noexcept {
+            sched_setaffinity(0, sizeof(old_cpus), &old_cpus);
+            restore_mempolicy();
+        }
+
+      private:
+        cpu_set_t old_cpus;
+        int old_mode = MPOL_DEFAULT;
+        unsigned long old_mask[mask_words] = {};
+
+        void restore_mempolicy() noexcept {
+            syscall(SYS_set_mempolicy, old_mode, old_mask, max_nodes + 1);
+        }
+    };
+
+    /**
+     * @brief Init `ring` with its memory and kernel threads on the node.
+     *
+     * @details The SQPOLL thread is pinned to the first CPU of the node,
+     * unless `params` already sets IORING_SETUP_SQ_AFF. io-wq workers may run
+     * on any CPU of the node (since 5.15).
+     */
+    template<uint64_t uring_flags>
+    void init_ring(
+        uring<uring_flags> &ring,
+        unsigned entries,
+        uring_params params = uring_params{static_cast<unsigned>(uring_flags)}
+    ) const {
+        if constexpr (uring_flags & IORING_SETUP_SQPOLL) {
+            if (!(params.flags & IORING_SETUP_SQ_AFF)) {
+                params.set_sq_thread_cpu(first);
+            }
+        }
+        {
+            const scope s{*this};
+            ring.init(entries, params);
+        }
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 15)
+        ring.register_iowq_aff(cpu_set);
+#endif
+    }
+
+    /**
+     * @brief `ring.setup_buf_ring(entries, bgid)` with the buffer ring on the
+     * node.
+     *
+     * @details The pages are pinned once registered, so `bind` can not move
+     * them afterwards.
+     */
+    template<uint64_t uring_flags>
+    [[nodiscard]]
+    buf_ring &setup_buf_ring(
+        uring<uring_flags> &ring, unsigned entries, uint16_t bgid
+    ) const {
+        const scope s{*this};
+        return ring.setup_buf_ring(entries, bgid);
+    }
+
+  private:
+    int node;
+    unsigned first = 0;
+    cpu_set_t cpu_set;
+
+    void set_bit(unsigned long (&mask)[mask_words]) const noexcept {
+        constexpr unsigned word_bits = 8 * sizeof(long);
+        mask[node / word_bits] |= 1UL << (node % word_bits);
+    }
+
+    // parse the cpulist of sysfs, e.g. "0-7,16-23"
+    void read_cpus() {
+        CPU_ZERO(&cpu_set);
+        const std::string path = "/sys/devices/system/node/node"
+                                 + std::to_string(node) + "/cpulist";
+        std::FILE *const file = std::fopen(path.c_str(), "re");
+        if (file == nullptr) [[unlikely]] {
+            throw std::system_error{
+                errno, std::system_category(), "numa_node " + path
+            };
+        }
+
+        bool has_cpu = false;
+        unsigned lo = 0;
+        unsigned hi = 0;
+        int sep = 0;
+        while (std::fscanf(file, "%u", &lo) == 1) {
+            hi = lo;
+            sep = std::fgetc(file);
+            if (sep == '-') {
+                if (std::fscanf(file, "%u", &hi) != 1) {
+                    break;
+                }
+                sep = std::fgetc(file);
+            }
+            for (unsigned cpu = lo; cpu <= hi && cpu < CPU_SETSIZE; ++cpu) {
+                if (!has_cpu) {
+                    first = cpu;
+                    has_cpu = true;
+                }
+                CPU_SET(cpu, &cpu_set);
+            }
+            if (sep != ',') {
+                break;
+            }
+        }
+        std::fclose(file);
+
+        if (!has_cpu) [[unlikely]] {
+            throw std::system_error{
+                ENODEV, std::system_category(), "numa_node has no CPU"
+            };
+        }
+    }
+};
+
+} // namespace liburingcxx
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <uring/uring.hpp>
+
+#include <cassert>
+#include <memory>
+
+namespace liburingcxx {
+
+/**
+ * @brief N rings sharing one SQPOLL kernel thread and io-wq.
+ *
+ * @details Ring 0 is the leader, inited by the constructor on the calling
+ * thread. Every other ring is attached to the leader by
+ * IORING_SETUP_ATTACH_WQ when `init(i)` is called. Call `init(i)` on the
+ * thread which will use ring `i`, since a ring is bound to the thread that
+ * registered its fd.
+ *
+ * ```
+ * ring_group<IORING_SETUP_SQPOLL> group{
+ *     shard_num, 256, uring_params{0}.set_sq_thread_cpu(0)
+ * };
+ * // on the thread of shard i > 0
+ * auto &ring = group.init(i);
+ * ```
+ */
+template<uint64_t uring_flags>
+class ring_group final {
+    static_assert(
+        !(uring_flags & IORING_SETUP_REGISTERED_FD_ONLY),
+        "ring_group attaches rings by the fd of the leader."
+    );
+
+  public:
+    /**
+     * @param ring_num number of rings, including the leader
+     * @param entries the size of sq ring of each ring. Must be pow of 2.
+     * @param params params of each ring, `wq_fd` is filled by the group
+     */
+    ring_group(
+        unsigned ring_num,
+        unsigned entries,
+        const uring_params &params =
+            uring_params{static_cast<unsigned>(uring_flags)}
+    )
+        : rings(std::make_unique<uring<uring_flags>[]>(ring_num))
+        , ring_num(ring_num)
+        , entries(entries)
+        , params(params) {
+        assert(ring_num != 0);
+        uring_params p = params;
+        rings[0].init(entries, p);
+    }
+
+    ring_group(const ring_group &) = delete;
+    ring_group &operator=(const ring_group &) = delete;
+
+    /**
+     * @brief Init ring `i` attached to the leader.
+     *
+     * @note Must be called on the thread using ring `i`.
+     */
+    uring<uring_flags> &init(unsigned i) {
+        assert(i != 0 && i < ring_num && "ring 0 is inited by the group");
+        uring_params p = params;
+        p.set_attach_wq(rings[0].fd());
+        rings[i].init(entries, p);
+        return rings[i];
+    }
+
+    /**
+     * @brief Init all rings but the leader on the calling thread.
+     */
+    void init_all() {
+        for (unsigned i = 1; i < ring_num; ++i) {
+            init(i);
+        }
+    }
+
+    [[nodiscard]]
+    uring<uring_flags> &operator[](unsigned i) noexcept {
+        assert(i < ring_num);
+        return rings[i];
+    }
+
+    [[nodiscard]]
+    uring<uring_flags> &leader() noexcept {
+        return rings[0];
+    }
+
+    [[nodiscard]]
+    unsigned size() const noexcept {
+        return ring_num;
+    }
+
+  private:
+    std::unique_ptr<uring<uring_flags>[]> rings;
+    const unsigned ring_num;
+    const unsigned entries;
+    const uring_params params;
+};
+
+} // namespace liburingcxx
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <uring/uring.hpp>
+
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <sched.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace liburingcxx {
+
+/**
+ * @brief A thread-safe pool of inited rings, for tasks which are too short to
+ * pay for `uring::init` each.
+ *
+ * @details All rings are inited by the constructor, so `io_uring_setup`, the
+ * mmaps and the SQ array setup are done up front. An idle ring has no
+ * registered ring fd, since the slots are per thread. `acquire` registers it
+ * on the calling thread, which is one cheap `io_uring_register`.
+ *
+ * Files, buffers and other registrations survive `release`, so they can be
+ * made once per ring right after the pool is constructed.
+ *
+ * ```
+ * // process-wide
+ * ring_pool<0> pool{64, 256};
+ *
+ * // in a task
+ * if (auto ring = pool.acquire()) {
+ *     ring->get_sq_entry()->prep_read(fd, buf, 0).set_data(data);
+ *     ring->submit_and_wait(1);
+ *     ...
+ * } // released here
+ * ```
+ */
+template<uint64_t uring_flags>
+class ring_pool final {
+    static_assert(
+        LIBURINGCXX_IS_KERNEL_REACH(6, 0),
+        "ring_pool resets a released ring by IORING_REGISTER_SYNC_CANCEL, "
+        "which needs Linux 6.0."
+    );
+    static_assert(
+        !(uring_flags & IORING_SETUP_REGISTERED_FD_ONLY),
+        "ring_pool moves rings across threads."
+    );
+    static_assert(
+        !(uring_flags
+          & (IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN)),
+        "ring_pool moves rings across threads, but only the thread which "
+        "created the ring may submit with IORING_SETUP_SINGLE_ISSUER."
+    );
+
+  public:
+    /**
+     * @brief A checked-out ring, returned to the pool on destruction.
+     *
+     * @note It must be destroyed on the thread which acquired it. A thread
+     * can hold at most 16 leases, the number of registered ring fd slots.
+     */
+    class lease final {
+      public:
+        lease() noexcept = default;
+
+        lease(lease &&other) noexcept
+            : pool(std::exchange(other.pool, nullptr))
+            , ring(std::move(other.ring))
+            , tid(other.tid) {}
+
+        lease &operator=(lease &&other) noexcept {
+            if (this != &other) {
+                reset();
+                pool = std::exchange(other.pool, nullptr);
+                ring = std::move(other.ring);
+                tid = other.tid;
+            }
+            return *this;
+        }
+
+        lease(const lease &) = delete;
+        lease &operator=(const lease &) = delete;
+
+        ~lease() noexcept { reset(); }
+
+        /**
+         * @brief Return the ring to the pool now.
+         */
+        void reset() noexcept {
+            if (ring) {
+                // the registered ring fd is in a slot of the acquiring thread
+                assert(
+                    tid == ::gettid()
+                    && "The lease is released on another thread."
+                );
+                pool->release(std::move(ring));
+            }
+        }
+
+        [[nodiscard]]
+        explicit operator bool() const noexcept {
+            return bool(ring);
+        }
+
+        [[nodiscard]]
+        uring<uring_flags> &operator*() const noexcept {
+            return *ring;
+        }
+
+        [[nodiscard]]
+        uring<uring_flags> *operator->() const noexcept {
+            return ring.get();
+        }
+
+      private:
+        ring_pool *pool = nullptr;
+        std::unique_ptr<uring<uring_flags>> ring;
+        // the acquiring thread
+        pid_t tid = 0;
+
+        lease(ring_pool *pool, std::unique_ptr<uring<uring_flags>> ring)
+            : pool(pool)
+            , ring(std::move(ring))
+            , tid(::gettid()) {}
+
+        friend class ring_pool;
+    };
+
+    /**
+     * @param ring_num number of rings
+     * @param entries the size of sq ring of each ring. Must be pow of 2.
+     * @param params params of each ring
+     */
+    ring_pool(
+        unsigned ring_num,
+        unsigned entries,
+        const uring_params &params =
+            uring_params{static_cast<unsigned>(uring_flags)}
+    ) {
+        idle.reserve(ring_num);
+        for (unsigned i = 0; i < ring_num; ++i) {
+            auto ring = std::make_unique<uring<uring_flags>>();
+            uring_params p = params;
+            ring->init(entries, p);
+            if constexpr (config::using_register_ring_fd) {
+                // only 16 slots per thread, do not hold them while idle
+                ring->unregister_ring_fd();
+            }
+            idle.push_back(std::move(ring));
+        }
+    }
+
+    ring_pool(const ring_pool &) = delete;
+    ring_pool &operator=(const ring_pool &) = delete;
+
+    /**
+     * @brief Call `f(ring)` on every idle ring, e.g. to register files or
+     * buffers once.
+     */
+    template<typename F>
+    void for_each_idle(F f) {
+        std::lock_guard lock{mutex};
+        for (auto &ring : idle) {
+            f(*ring);
+        }
+    }
+
+    /**
+     * @brief Check out an idle ring for the calling thread.
+     *
+     * @return an empty lease if all rings are checked out
+     */
+    [[nodiscard]]
+    lease acquire() {
+        std::unique_ptr<uring<uring_flags>> ring;
+        {
+            std::lock_guard lock{mutex};
+            if (idle.empty()) [[unlikely]] {
+                return {};
+            }
+            ring = std::move(idle.back());
+            idle.pop_back();
+        }
+        if constexpr (config::using_register_ring_fd) {
+            try {
+                ring->register_ring_fd();
+            } catch (...) {
+                std::lock_guard lock{mutex};
+                idle.push_back(std::move(ring));
+                throw;
+            }
+        }
+        return lease{this, std::move(ring)};
+    }
+
+    [[nodiscard]]
+    unsigned idle_num() const noexcept {
+        std::lock_guard lock{mutex};
+        return static_cast<unsigned>(idle.size());
+    }
+
+  private:
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<uring<uring_flags>>> idle;
+
+    /**
+     * @brief Reset a ring and put it back.
+     *
+     * @details In-flight requests are cancelled until none is left, then all
+     * cqes are discarded, including those posted by task work or flushed from
+     * the overflow list. A ring which fails to cancel is closed instead, so
+     * the pool shrinks by one.
+     *
+     * Sqes got but not submitted are not tracked by `uring`, so the lease
+     * holder must not leave any behind.
+     */
+    void release(std::unique_ptr<uring<uring_flags>> ring) noexcept {
+        if constexpr (uring_flags & IORING_SETUP_SQPOLL) {
+            // submitted sqes are invisible to cancel until consumed
+            while (ring->sq_pending() != 0) {
+                ring->submit();
+                sched_yield();
+            }
+        } else {
+            assert(ring->sq_pending() == 0 && "unsubmitted sqes are left");
+        }
+        if (ring->sync_cancel_all() != 0) [[unlikely]] {
+            return;
+        }
+        for (;;) {
+            ring->get_events();
+            const unsigned ready = ring->cq_ready_acquire();
+            if (ready == 0) {
+                break;
+            }
+            ring->cq_advance(ready);
+        }
+        if constexpr (config::using_register_ring_fd) {
+            try {
+                ring->unregister_ring_fd();
+            } catch (...) {
+                // the slot leaks until this thread exits
+            }
+        }
+        std::lock_guard lock{mutex};
+        idle.push_back(std::move(ring));
+    }
+};
+
+} // namespace liburingcxx
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <uring/uring.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <numeric>
+#include <system_error>
+#include <thread>
+
+namespace liburingcxx {
+
+/**
+ * @brief A userspace stand-in for the kernel side of an io_uring.
+ *
+ * @details The simulator maps fake SQ/CQ rings with the layout `mmap_queue`
+ * expects, and attaches a `uring` to them. A companion thread plays the
+ * SQPOLL kernel thread: it consumes SQEs and posts one CQE per SQE
+ * (`res` is 0, or `len` for read/write ops) after `latency`. This makes the
+ * userspace cost of `uring` measurable without kernel variance.
+ *
+ * The attached `uring` has no ring fd, so anything that enters the kernel
+ * (e.g. `wait_cq_entry`) fails with -EBADF. Poll the CQ with `for_each_cqe`,
+ * `peek_batch_cq_entries` or `cq_ready_acquire` instead.
+ *
+ * @tparam uring_flags must contain IORING_SETUP_SQPOLL
+ */
+template<uint64_t uring_flags>
+class ring_simulator final {
+    static_assert(
+        uring_flags & IORING_SETUP_SQPOLL,
+        "ring_simulator completes SQEs like an SQPOLL thread, "
+        "IORING_SETUP_SQPOLL is required."
+    );
+
+  public:
+    /**
+     * @param ring an uninitialized ring to be attached
+     * @param entries the size of sq ring. Must be pow of 2.
+     * @param latency delay between consuming an SQE and posting its CQE
+     */
+    ring_simulator(
+        uring<uring_flags> &ring,
+        unsigned entries,
+        std::chrono::nanoseconds latency = {}
+    );
+
+    ~ring_simulator() noexcept;
+
+    ring_simulator(const ring_simulator &) = delete;
+    ring_simulator &operator=(const ring_simulator &) = delete;
+
+    /**
+     * @brief Number of SQEs completed so far.
+     */
+    [[nodiscard]]
+    uint64_t completed() const noexcept {
+        return completed_num.load(std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr int sqe_shift =
+        bool(uring_flags & IORING_SETUP_SQE128) ? 1 : 0;
+    static constexpr int cqe_shift =
+        bool(uring_flags & IORING_SETUP_CQE32) ? 1 : 0;
+
+    // the kernel keeps heads and tails on separate cache lines as well
+    struct kernel_rings {
+        alignas(64) unsigned sq_head;
+        alignas(64) unsigned sq_tail;
+        alignas(64) unsigned cq_head;
+        alignas(64) unsigned cq_tail;
+        alignas(64) unsigned sq_ring_mask;
+        unsigned sq_ring_entries;
+        unsigned sq_flags;
+        unsigned sq_dropped;
+        unsigned cq_ring_mask;
+        unsigned cq_ring_entries;
+        unsigned cq_flags;
+        unsigned cq_overflow;
+        alignas(64) io_uring_cqe cqes[];
+    };
+
+    uring<uring_flags> &ring;
+    const std::chrono::nanoseconds latency;
+    kernel_rings *rings;
+    unsigned *sq_array;
+    io_uring_sqe *sqes;
+    size_t rings_size;
+    size_t sqes_size;
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> completed_num{0};
+    std::thread poller;
+
+    void poll() noexcept;
+};
+
+template<uint64_t uring_flags>
+ring_simulator<uring_flags>::ring_simulator(
+    uring<uring_flags> &ring, unsigned entries, std::chrono::nanoseconds latency
+)
+    : ring(ring)
+    , latency(latency) {
+    assert(ring.enter_ring_fd == -1 && "The uring may be inited twice.");
+    assert((entries & (entries - 1)) == 0 && "entries must be pow of 2");
+
+    const unsigned cq_entries = entries * 2;
+    const size_t cqes_size = (sizeof(io_uring_cqe) * cq_entries) << cqe_shift;
+    const size_t array_offset = sizeof(kernel_rings) + cqes_size;
+    rings_size = array_offset + sizeof(unsigned) * entries;
+    sqes_size = (sizeof(io_uring_sqe) * entries) << sqe_shift;
+
+    void *const rings_ptr = __sys_mmap(
+        nullptr, rings_size, PROT_READ | PROT_WRITE,
+        MAP_ANONYMOUS | MAP_PRIVATE | MAP_POPULATE, -1, 0
+    );
+    if (IS_ERR(rings_ptr)) [[unlikely]] {
+        throw std::system_error{
+            -PTR_ERR(rings_ptr), std::system_category(),
+            "ring_simulator rings mmap"
+        };
+    }
+    void *const sqes_ptr = __sys_mmap(
+        nullptr, sqes_size, PROT_READ | PROT_WRITE,
+        MAP_ANONYMOUS | MAP_PRIVATE | MAP_POPULATE, -1, 0
+    );
+    if (IS_ERR(sqes_ptr)) [[unlikely]] {
+        __sys_munmap(rings_ptr, rings_size);
+        throw std::system_error{
+            -PTR_ERR(sqes_ptr), std::system_category(),
+            "ring_simulator sqes mmap"
+        };
+    }
+
+    rings = static_cast<kernel_rings *>(rings_ptr);
+    sqes = static_cast<io_uring_sqe *>(sqes_ptr);
+    sq_array = reinterpret_cast<unsigned *>(
+        static_cast<char *>(rings_ptr) + array_offset
+    );
+    rings->sq_ring_mask = entries - 1;
+    rings->sq_ring_entries = entries;
+    rings->cq_ring_mask = cq_entries - 1;
+    rings->cq_ring_entries = cq_entries;
+    std::iota(sq_array, sq_array + entries, 0U);
+
+    uring_params p{static_cast<unsigned>(uring_flags)};
+    p.sq_entries = entries;
+    p.cq_entries = cq_entries;
+    p.features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP
+                 | IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_EXT_ARG
+                 | IORING_FEAT_CQE_SKIP;
+    p.sq_off.head = offsetof(kernel_rings, sq_head);
+    p.sq_off.tail = offsetof(kernel_rings, sq_tail);
+    p.sq_off.ring_mask = offsetof(kernel_rings, sq_ring_mask);
+    p.sq_off.ring_entries = offsetof(kernel_rings, sq_ring_entries);
+    p.sq_off.flags = offsetof(kernel_rings, sq_flags);
+    p.sq_off.dropped = offsetof(kernel_rings, sq_dropped);
+    p.sq_off.array = array_offset;
+    p.cq_off.head = offsetof(kernel_rings, cq_head);
+    p.cq_off.tail = offsetof(kernel_rings, cq_tail);
+    p.cq_off.ring_mask = offsetof(kernel_rings, cq_ring_mask);
+    p.cq_off.ring_entries = offsetof(kernel_rings, cq_ring_entries);
+    p.cq_off.overflow = offsetof(kernel_rings, cq_overflow);
+    p.cq_off.cqes = offsetof(kernel_rings, cqes);
+    p.cq_off.flags = offsetof(kernel_rings, cq_flags);
+
+    ring.reset_state();
+    ring.features = p.features;
+    ring.int_flags = INT_FLAG_APP_MEM;
+    ring.attach_rings(
+        p, rings_ptr, rings_ptr, reinterpret_cast<sq_entry *>(sqes_ptr)
+    );
+
+    poller = std::thread{[this] { poll(); }};
+}
+
+template<uint64_t uring_flags>
+ring_simulator<uring_flags>::~ring_simulator() noexcept {
+    running.store(false, std::memory_order_relaxed);
+    poller.join();
+    ring.reset_state();
+    __sys_munmap(sqes, sqes_size);
+    __sys_munmap(rings, rings_size);
+}
+
+template<uint64_t uring_flags>
+void ring_simulator<uring_flags>::poll() noexcept {
+    using clock = std::chrono::steady_clock;
+
+    while (running.load(std::memory_order_relaxed)) {
+        const unsigned sq_tail = io_uring_smp_load_acquire(&rings->sq_tail);
+        unsigned sq_head = rings->sq_head;
+        const unsigned consumed = sq_tail - sq_head;
+        if (consumed == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (latency.count() != 0) {
+            const auto deadline = clock::now() + latency;
+            while (clock::now() < deadline) {}
+        }
+
+        unsigned cq_tail = rings->cq_tail;
+        for (; sq_head != sq_tail; ++sq_head) {
+            const unsigned index = sq_array[sq_head & rings->sq_ring_mask];
+            const io_uring_sqe &sqe = sqes[index << sqe_shift];
+
+            if (!(sqe.flags & IOSQE_CQE_SKIP_SUCCESS)) {
+                // wait for room in the CQ, the kernel would overflow instead
+                while (cq_tail - io_uring_smp_load_acquire(&rings->cq_head)
+                       >= rings->cq_ring_entries) {
+                    io_uring_smp_store_release(&rings->cq_tail, cq_tail);
+                    // nobody may reap the CQ any more
+                    if (!running.load(std::memory_order_relaxed)) [[unlikely]] {
+                        return;
+                    }
+                    std::this_thread::yield();
+                }
+
+                io_uring_cqe &cqe =
+                    rings->cqes[(cq_tail & rings->cq_ring_mask) << cqe_shift];
+                cqe.user_data = sqe.user_data;
+                cqe.flags = 0;
+                switch (sqe.opcode) {
+                    case IORING_OP_READ:
+                    case IORING_OP_WRITE:
+                    case IORING_OP_READ_FIXED:
+                    case IORING_OP_WRITE_FIXED:
+                        cqe.res = static_cast<int32_t>(sqe.len);
+                        break;
+                    default: cqe.res = 0; break;
+                }
+                ++cq_tail;
+            }
+        }
+
+        io_uring_smp_store_release(&rings->sq_head, sq_head);
+        io_uring_smp_store_release(&rings->cq_tail, cq_tail);
+        completed_num.fetch_add(consumed, std::memory_order_relaxed);
+    }
+}
+
+} // namespace liburingcxx
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <uring/uring.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+namespace liburingcxx {
+
+/**
+ * @brief Let other threads issue I/O on a ring owned by one thread.
+ *
+ * @details Each producer thread stages sqes in its own `producer`, and
+ * `publish()`es them in batches to a lock-free MPSC queue. The owner thread
+ * of the ring calls `drain()` before `submit()`, which copies staged sqes into
+ * the SQ by `sq_entry::clone_from`. Producers never touch the ring, so
+ * `uring` itself needs no synchronization.
+ *
+ * A batch is allocated when a producer starts staging into it, and freed by
+ * the owner once it is fully copied.
+ *
+ * ```
+ * // producer thread
+ * auto p = stage.make_producer();
+ * p.get_sq_entry().prep_write(fd, buf, 0).set_data(data);
+ * p.publish();
+ *
+ * // owner thread
+ * stage.drain();
+ * ring.submit();
+ * ```
+ *
+ * @note The owner is not woken up by `publish()`. It should drain on its own
+ * schedule, e.g. with a timeout of `wait_cq_entries`.
+ */
+template<uint64_t uring_flags>
+class staged_submitter final {
+    static_assert(
+        !(uring_flags & IORING_SETUP_SQE128),
+        "staged_submitter does not support IORING_SETUP_SQE128 yet."
+    );
+
+  public:
+    static constexpr unsigned batch_size = 32;
+
+  private:
+    struct batch {
+        batch *next = nullptr;
+        unsigned staged = 0;
+        unsigned drained = 0;
+        sq_entry sqes[batch_size];
+    };
+
+  public:
+    /**
+     * @brief Stages sqes of one thread. Not thread-safe by itself.
+     */
+    class producer final {
+      public:
+        producer(producer &&other) noexcept
+            : stage(other.stage)
+            , current(other.current) {
+            other.current = nullptr;
+        }
+
+        producer(const producer &) = delete;
+        producer &operator=(const producer &) = delete;
+        producer &operator=(producer &&) = delete;
+
+        ~producer() noexcept { publish(); }
+
+        /**
+         * @brief Return an sqe to fill. It is sent to the ring by the next
+         * `publish()`.
+         *
+         * @details A full batch is published automatically. A link chain is
+         * never split by that: its staged sqes move to the next batch, so
+         * sqes of other producers can not be drained into the middle of it.
+         *
+         * @throw std::system_error with E2BIG if a link chain does not fit
+         * in one batch
+         */
+        [[nodiscard]]
+        sq_entry &get_sq_entry() {
+            if (current == nullptr) {
+                current = new batch;
+            } else if (current->staged == batch_size) [[unlikely]] {
+                const unsigned linked = open_chain_size(*current);
+                if (linked == batch_size) [[unlikely]] {
+                    throw std::system_error{
+                        E2BIG, std::system_category(),
+                        "staged_submitter: link chain exceeds batch_size"
+                    };
+                }
+                batch *const next = new batch;
+                current->staged -= linked;
+                for (unsigned i = 0; i < linked; ++i) {
+                    const sq_entry &sqe = current->sqes[current->staged + i];
+                    next->sqes[i].clone_from(sqe);
+                }
+                next->staged = linked;
+                publish();
+                current = next;
+            }
+            return current->sqes[current->staged++];
+        }
+
+        /**
+         * @brief Hand all staged sqes over to the owner of the ring.
+         *
+         * @note Do not publish in the middle of a link chain.
+         */
+        void publish() noexcept {
+            if (current == nullptr || current->staged == 0) {
+                return;
+            }
+            assert(
+                open_chain_size(*current) == 0
+                && "A link chain is published before its last sqe."
+            );
+            stage.push(current);
+            current = nullptr;
+        }
+
+      private:
+        staged_submitter &stage;
+        batch *current = nullptr;
+
+        // number of trailing sqes of `b` linked to a sqe not staged yet
+        static unsigned open_chain_size(const batch &b) noexcept {
+            constexpr uint8_t link_flags = IOSQE_IO_LINK | IOSQE_IO_HARDLINK;
+            unsigned n = 0;
+            while (n < b.staged
+                   && (b.sqes[b.staged - 1 - n].get_flags() & link_flags)) {
+                ++n;
+            }
+            return n;
+        }
+
+        explicit producer(staged_submitter &stage) noexcept
+            : stage(stage) {}
+
+        friend class staged_submitter;
+    };
+
+    explicit staged_submitter(uring<uring_flags> &ring) noexcept
+        : ring(ring) {}
+
+    ~staged_submitter() noexcept {
+        free_list(published.exchange(nullptr, std::memory_order_acquire));
+        free_list(pending_head);
+    }
+
+    staged_submitter(const staged_submitter &) = delete;
+    staged_submitter &operator=(const staged_submitter &) = delete;
+
+    /**
+     * @brief Create a producer for the calling thread.
+     *
+     * @note Producers must be destroyed before the `staged_submitter`.
+     */
+    [[nodiscard]]
+    producer make_producer() noexcept {
+        return producer{*this};
+    }
+
+    /**
+     * @brief Copy published sqes into the SQ. Owner thread only.
+     *
+     * @details sqes are copied in publishing order. If the SQ is full, the
+     * rest are kept for the next `drain()`.
+     *
+     * @return number of sqes copied
+     */
+    unsigned drain() noexcept {
+        take_published();
+
+        unsigned copied = 0;
+        while (pending_head != nullptr) {
+            batch *const b = pending_head;
+            for (; b->drained != b->staged; ++b->drained, ++copied) {
+                sq_entry *const sqe = ring.get_sq_entry();
+                if (sqe == nullptr) [[unlikely]] {
+                    return copied;
+                }
+                sqe->clone_from(b->sqes[b->drained]);
+                if constexpr (uring_flags & uring_setup::sqe_reorder) {
+                    ring.append_sq_entry(sqe);
+                }
+            }
+            pending_head = b->next;
+            delete b;
+        }
+        pending_tail = nullptr;
+        return copied;
+    }
+
+    /**
+     * @brief Whether some published sqes are not copied yet. Owner thread
+     * only.
+     */
+    [[nodiscard]]
+    bool has_pending() const noexcept {
+        return pending_head != nullptr
+               || published.load(std::memory_order_relaxed) != nullptr;
+    }
+
+  private:
+    uring<uring_flags> &ring;
+    // LIFO stack pushed by producers
+    alignas(64) std::atomic<batch *> published{nullptr};
+    // FIFO list only touched by the owner
+    alignas(64) batch *pending_head = nullptr;
+    batch *pending_tail = nullptr;
+
+    void push(batch *b) noexcept {
+        b->next = published.load(std::memory_order_relaxed);
+        while (!published.compare_exchange_weak(
+            b->next, b, std::memory_order_release, std::memory_order_relaxed
+        )) {}
+    }
+
+    void take_published() noexcept {
+        batch *stack = published.exchange(nullptr, std::memory_order_acquire);
+        if (stack == nullptr) {
+            return;
+        }
+
+        // reverse into publishing order
+        batch *head = nullptr;
+        batch *const tail = stack;
+        while (stack != nullptr) {
+            batch *const next = stack->next;
+            stack->next = head;
+            head = stack;
+            stack = next;
+        }
+
+        if (pending_tail == nullptr) {
+            pending_head = head;
+        } else {
+            pending_tail->next = head;
+        }
+        pending_tail = tail;
+    }
+
+    static void free_list(batch *b) noexcept {
+        while (b != nullptr) {
+            batch *const next = b->next;
+            delete b;
+            b = next;
+        }
+    }
+};
+
+} // namespace liburingcxx
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <uring/uring_define.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+namespace liburingcxx {
+
+namespace detail {
+
+// bits of `user_data` below `fire_and_forget_flag`
+inline constexpr unsigned user_data_bits =
+    std::countr_zero(fire_and_forget_flag);
+
+} // namespace detail
+
+/**
+ * @brief A compile-time layout of `user_data`: op tag, generation and slot
+ * index packed into 63 bits.
+ *
+ * @details From bit 62 down: `tag_bits` of tag, then `generation_bits` of
+ * generation, then `index_bits` of index. Bit 63 is `fire_and_forget_flag`
+ * and is always clear, so encoded values are never taken for a
+ * fire-and-forget CQE by `uring::for_each_cqe(f, on_failure)`. Dispatching on
+ * `tag(cqe->user_data)` needs no dereference of the op context, and the
+ * encoded value addresses exactly one op, e.g. for `prep_cancle`.
+ *
+ * `index_bits` defaults to the rest of the 63 bits, but at most 32.
+ *
+ * ```
+ * enum class op : uint8_t { accept, recv, send };
+ * using schema = user_data_schema<op, 7, 24>; // 32 bits of index
+ * sqe.set_data(schema::encode(op::recv, index, generation));
+ * switch (schema::tag(cqe->user_data)) { ... }
+ * ```
+ *
+ * @tparam Tag an enum or integral type of the op tag
+ */
+template<
+    typename Tag,
+    unsigned tag_bits,
+    unsigned generation_bits,
+    unsigned index_bits =
+        std::min(32U, detail::user_data_bits - tag_bits - generation_bits)>
+struct user_data_schema {
+    static_assert(std::is_enum_v<Tag> || std::is_integral_v<Tag>);
+    static_assert(
+        tag_bits + generation_bits + index_bits <= detail::user_data_bits,
+        "bit 63 is reserved for fire_and_forget_flag"
+    );
+    static_assert(generation_bits <= 32 && index_bits <= 32);
+    static_assert(index_bits != 0);
+
+    using tag_type = Tag;
+
+    static constexpr unsigned index_shift = 0;
+    static constexpr unsigned generation_shift = index_bits;
+    static constexpr unsigned tag_shift = index_bits + generation_bits;
+
+    static constexpr uint64_t index_mask = (1ULL << index_bits) - 1;
+    static constexpr uint64_t generation_mask = (1ULL << generation_bits) - 1;
+    static constexpr uint64_t tag_mask = (1ULL << tag_bits) - 1;
+
+    /**
+     * @brief Pack the fields into a `user_data`.
+     *
+     * @details `generation` is truncated to `generation_bits`, so it may
+     * simply wrap around. `index` and `tag` must fit their fields.
+     */
+    [[nodiscard]]
+    static constexpr uint64_t
+    encode(Tag tag, uint32_t index, uint32_t generation = 0) noexcept {
+        const auto raw_tag = static_cast<uint64_t>(tag);
+        assert((raw_tag & ~tag_mask) == 0 && "tag overflows its field");
+        assert((index & ~index_mask) == 0 && "index overflows its field");
+        return (raw_tag & tag_mask) << tag_shift
+               | (generation & generation_mask) << generation_shift
+               | (index & index_mask) << index_shift;
+    }
+
+    [[nodiscard]]
+    static constexpr Tag tag(uint64_t user_data) noexcept {
+        if constexpr (tag_bits == 0) {
+            return Tag{};
+        } else {
+            return static_cast<Tag>(user_data >> tag_shift & tag_mask);
+        }
+    }
+
+    [[nodiscard]]
+    static constexpr uint32_t generation(uint64_t user_data) noexcept {
+        return static_cast<uint32_t>(
+            user_data >> generation_shift & generation_mask
+        );
+    }
+
+    [[nodiscard]]
+    static constexpr uint32_t index(uint64_t user_data) noexcept {
+        return static_cast<uint32_t>(user_data >> index_shift & index_mask);
+    }
+
+    /**
+     * @brief Whether `generation` equals the one stored in `user_data`,
+     * modulo the field width.
+     */
+    [[nodiscard]]
+    static constexpr bool
+    match_generation(uint64_t user_data, uint32_t generation) noexcept {
+        return (generation & generation_mask)
+               == (user_data >> generation_shift & generation_mask);
+    }
+};
+
+/**
+ * @brief The untagged schema of `context_pool`: 31 bits of generation and 32
+ * bits of index.
+ */
+using default_user_data_schema = user_data_schema<uint8_t, 0, 31>;
+
+} // namespace liburingcxx
@@ -0,0 +1,831 @@
+/*
+ *  A behavior tester of the utilities of liburingcxx.
+ *
+ *  Copyright (C) 2022 Zifeng Deng
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <uring/uring.hpp>
+#include <uring/utility/context_pool.hpp>
+#include <uring/utility/fdinfo.hpp>
+#include <uring/utility/ring_pool.hpp>
+#include <uring/utility/ring_simulator.hpp>
+#include <uring/utility/staged_submitter.hpp>
+#include <uring/utility/user_data.hpp>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// not assert, so the checks also run in Release builds
+int failed_num = 0;
+
+void check(bool ok, const char *what, int line) {
+    if (!ok) {
+        std::cerr << "line " << line << ": " << what << " failed\n";
+        ++failed_num;
+    }
+}
+
+#define CHECK(...) check((__VA_ARGS__), #__VA_ARGS__, __LINE__)
+
+constexpr uint64_t sim_flags = IORING_SETUP_SQPOLL;
+constexpr uint64_t sim_reorder_flags =
+    IORING_SETUP_SQPOLL | liburingcxx::uring_setup::sqe_reorder;
+constexpr uint64_t defer_flags =
+    IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+
+io_uring_sqe raw(const liburingcxx::sq_entry &sqe) {
+    io_uring_sqe r;
+    std::memcpy(&r, &sqe, sizeof(r));
+    return r;
+}
+
+// user_data of `num` cqes posted by a simulated ring, in order
+template<uint64_t uring_flags>
+std::vector<uint64_t>
+reap(liburingcxx::uring<uring_flags> &ring, unsigned num) {
+    std::vector<uint64_t> data;
+    while (data.size() < num) {
+        const unsigned n = ring.for_each_cqe([&](liburingcxx::cq_entry *cqe) {
+            data.push_back(cqe->user_data);
+        });
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        ring.cq_advance(n);
+    }
+    return data;
+}
+
+void check_user_data_schema() {
+    using namespace liburingcxx;
+
+    enum class op : uint8_t { accept, recv, send = 127 };
+    using schema = user_data_schema<op, 7, 24>;
+    static_assert(schema::tag_shift == 56 && schema::generation_shift == 32);
+    static_assert(schema::index_mask == 0xffff'ffff);
+
+    // the index defaults to at most 32 bits
+    using wide = user_data_schema<op, 8, 16>;
+    static_assert(wide::tag_shift == 48 && wide::index_mask == 0xffff'ffff);
+
+    // bit 63 is kept clear, even with every field full
+    static_assert(!(schema::encode(op::send, ~0U, ~0U) & fire_and_forget_flag));
+    using fallback = default_user_data_schema;
+    static_assert(!(fallback::encode(0, ~0U, ~0U) & fire_and_forget_flag));
+
+    for (const op o : {op::accept, op::recv, op::send}) {
+        for (const uint32_t index : {0U, 1U, 0xffff'ffffU}) {
+            for (const uint32_t gen : {0U, 1U, 0xff'ffffU}) {
+                const uint64_t data = schema::encode(o, index, gen);
+                CHECK(schema::tag(data) == o);
+                CHECK(schema::index(data) == index);
+                CHECK(schema::generation(data) == gen);
+                CHECK(schema::match_generation(data, gen));
+                CHECK(!schema::match_generation(data, gen + 1));
+            }
+        }
+    }
+
+    // the generation wraps around in its field
+    const uint64_t data = schema::encode(op::recv, 5, 0x100'0001);
+    CHECK(schema::generation(data) == 1);
+    CHECK(schema::match_generation(data, 0x100'0001));
+}
+
+void check_context_pool() {
+    using namespace liburingcxx;
+
+    struct context {
+        int value;
+    };
+    context_pool<context> pool{2};
+    CHECK(pool.capacity() == 2 && pool.size() == 0);
+
+    context *const a = pool.emplace(context{1});
+    context *const b = pool.emplace(context{2});
+    CHECK(a != nullptr && b != nullptr && a != b);
+    CHECK(pool.full() && pool.emplace(context{3}) == nullptr);
+
+    const uint64_t data_a = pool.user_data(a);
+    const uint64_t data_b = pool.user_data(b);
+    CHECK(pool.find(data_a) == a && pool.find(data_b) == b);
+
+    // a stale user_data is rejected, even if its slot is reused
+    pool.erase(a);
+    CHECK(pool.find(data_a) == nullptr);
+    context *const c = pool.emplace(context{3});
+    CHECK(c == a);
+    CHECK(pool.find(data_a) == nullptr);
+    CHECK(pool.find(pool.user_data(c)) == c && c->value == 3);
+
+    // an index out of the pool is rejected
+    CHECK(pool.find(default_user_data_schema::encode(0, 2, 1)) == nullptr);
+
+    // the tag rides along
+    enum class op : uint8_t { read, write };
+    using schema = user_data_schema<op, 7, 24>;
+    context_pool<context, schema> tagged{1};
+    context *const d = tagged.emplace();
+    const uint64_t data_d = tagged.user_data(d, op::write);
+    CHECK(schema::tag(data_d) == op::write && tagged.find(data_d) == d);
+}
+
+void check_sq_chain() {
+    using namespace liburingcxx;
+    constexpr uint8_t link_flags =
+        IOSQE_IO_LINK | IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS;
+
+    uring<sim_flags> ring;
+    ring_simulator<sim_flags> sim{ring, 8};
+    {
+        auto chain = ring.get_sq_chain<3>(chain_link::soft, true);
+        CHECK(bool(chain));
+        for (unsigned i = 0; i < 3; ++i) {
+            chain[i].prep_nop().set_data(i);
+        }
+        chain.commit();
+        constexpr uint8_t linked = IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS;
+        CHECK((raw(chain[0]).flags & link_flags) == linked);
+        CHECK((raw(chain[1]).flags & link_flags) == linked);
+        CHECK((raw(chain[2]).flags & link_flags) == 0);
+    }
+    ring.submit();
+    // only the last entry posts a CQE on success
+    CHECK(reap(ring, 1) == std::vector<uint64_t>{2});
+    CHECK(sim.completed() == 3);
+
+    {
+        auto chain = ring.get_sq_chain<2>(chain_link::hard);
+        chain[0].prep_nop();
+        chain[1].prep_nop();
+        chain.commit();
+        CHECK((raw(chain[0]).flags & link_flags) == IOSQE_IO_HARDLINK);
+        CHECK((raw(chain[1]).flags & link_flags) == 0);
+    }
+    ring.submit();
+    CHECK(reap(ring, 2).size() == 2);
+
+    // all or nothing
+    CHECK(!ring.get_sq_chain<16>());
+
+    // append_sq_chain commits the chain itself
+    uring<sim_reorder_flags> reorder;
+    ring_simulator<sim_reorder_flags> reorder_sim{reorder, 8};
+    {
+        auto chain = reorder.get_sq_chain<2>();
+        chain[0].prep_nop();
+        chain[1].prep_nop();
+        reorder.append_sq_chain(chain);
+        CHECK((raw(chain[0]).flags & link_flags) == IOSQE_IO_LINK);
+    }
+    reorder.submit();
+    CHECK(reap(reorder, 2).size() == 2);
+}
+
+// two sqes holding different garbage, so every byte must be written
+struct sqe_pair {
+    liburingcxx::sq_entry expect;
+    liburingcxx::sq_entry actual;
+
+    sqe_pair() noexcept {
+        std::memset(static_cast<void *>(&expect), 0xa5, sizeof(expect));
+        std::memset(static_cast<void *>(&actual), 0x5a, sizeof(actual));
+    }
+
+    bool same() const noexcept {
+        return std::memcmp(&expect, &actual, sizeof(expect)) == 0;
+    }
+};
+
+// fill_rw must match prep_rw, which prep_read and prep_write call
+void check_fill_rw() {
+    char buf[16];
+    {
+        sqe_pair p;
+        p.expect.prep_read(3, buf, 4096).set_data(42);
+        p.actual.fill_rw(IORING_OP_READ, 3, buf, sizeof(buf), 4096, 42);
+        CHECK(p.same());
+    }
+    {
+        sqe_pair p;
+        p.expect.prep_write(-1, {buf, 1}, -1ULL)
+            .set_data(-1ULL)
+            .reset_flags(IOSQE_FIXED_FILE | IOSQE_IO_LINK);
+        p.actual.fill_rw(
+            IORING_OP_WRITE, -1, buf, 1, -1ULL, -1ULL,
+            IOSQE_FIXED_FILE | IOSQE_IO_LINK
+        );
+        CHECK(p.same());
+    }
+}
+
+void check_sqe_template() {
+    using namespace liburingcxx;
+    char buf[16];
+    {
+        sqe_template<0> tpl;
+        tpl.image().prep_read(3, {}, 0).set_fixed_file();
+        sqe_pair p;
+        p.expect.prep_read(3, buf, 4096).set_data(42).set_fixed_file();
+        tpl.stamp(p.actual, buf, sizeof(buf), 4096, 42);
+        CHECK(p.same());
+    }
+    {
+        sqe_template<0> tpl;
+        tpl.image().prep_nop().set_link();
+        sqe_pair p;
+        p.expect.prep_nop().set_data(7).set_link();
+        tpl.stamp(p.actual, 7);
+        CHECK(p.same());
+    }
+    {
+        // the stamp covers both halves of a 128-byte sqe
+        constexpr uint64_t flags = IORING_SETUP_SQE128;
+        static_assert(sqe_template<flags>::image_size == 128);
+        sqe_template<flags> tpl;
+        tpl.image().prep_nop();
+        alignas(64) sq_entry sqe[2];
+        std::memset(static_cast<void *>(sqe), 0x5a, sizeof(sqe));
+        tpl.stamp(sqe[0], 7);
+        sq_entry expect[2];
+        std::memset(static_cast<void *>(expect), 0, sizeof(expect));
+        expect[0].prep_nop().set_data(7);
+        CHECK(std::memcmp(sqe, expect, sizeof(sqe)) == 0);
+    }
+}
+
+// drain and submit until `num` cqes are reaped
+template<uint64_t uring_flags>
+std::vector<uint64_t> drain_all(
+    liburingcxx::uring<uring_flags> &ring,
+    liburingcxx::staged_submitter<uring_flags> &stage,
+    unsigned num
+) {
+    std::vector<uint64_t> data;
+    while (data.size() < num) {
+        const unsigned copied = stage.drain();
+        ring.submit();
+        const std::vector<uint64_t> got = reap(ring, copied);
+        data.insert(data.end(), got.begin(), got.end());
+    }
+    return data;
+}
+
+template<uint64_t uring_flags>
+void check_staged_submitter() {
+    using namespace liburingcxx;
+    // an SQ of 8 entries is smaller than a batch
+    uring<uring_flags> ring;
+    ring_simulator<uring_flags> sim{ring, 8};
+    staged_submitter<uring_flags> stage{ring};
+
+    // batches of one producer keep their publishing order, and a full batch
+    // is published automatically
+    {
+        auto p = stage.make_producer();
+        for (uint64_t i = 0; i < 40; ++i) {
+            p.get_sq_entry().prep_nop().set_data(i);
+            if (i == 1 || i == 2) {
+                p.publish();
+            }
+        }
+        p.publish();
+        p.publish(); // nothing staged
+    }
+    CHECK(stage.drain() == 8);
+    CHECK(stage.has_pending());
+    ring.submit();
+    std::vector<uint64_t> data = reap(ring, 8);
+    const std::vector<uint64_t> rest = drain_all(ring, stage, 32);
+    data.insert(data.end(), rest.begin(), rest.end());
+    std::vector<uint64_t> expect(40);
+    for (uint64_t i = 0; i < 40; ++i) {
+        expect[i] = i;
+    }
+    CHECK(data == expect);
+    CHECK(!stage.has_pending());
+
+    // sqes of each producer stay in order across threads
+    constexpr unsigned producer_num = 3;
+    constexpr uint64_t per_producer = 100;
+    std::vector<std::thread> producers;
+    for (uint64_t id = 0; id < producer_num; ++id) {
+        producers.emplace_back([&stage, id] {
+            auto p = stage.make_producer();
+            for (uint64_t i = 0; i < per_producer; ++i) {
+                p.get_sq_entry().prep_nop().set_data(id << 32 | i);
+                if (i % 7 == 6) {
+                    p.publish();
+                }
+            }
+        });
+    }
+    for (std::thread &t : producers) {
+        t.join();
+    }
+    data = drain_all(ring, stage, producer_num * per_producer);
+    uint64_t next[producer_num] = {};
+    bool ordered = true;
+    for (const uint64_t d : data) {
+        const uint64_t id = d >> 32;
+        ordered = ordered && id < producer_num && (d & ~0U) == next[id]++;
+    }
+    CHECK(ordered);
+    CHECK(data.size() == producer_num * per_producer);
+
+    // a link chain crossing a full batch moves to the next batch as a whole,
+    // so no other sqe is drained into the middle of it
+    constexpr unsigned unlinked = staged_submitter<uring_flags>::batch_size - 2;
+    {
+        auto a = stage.make_producer();
+        auto b = stage.make_producer();
+        uint64_t i = 0;
+        for (; i < unlinked; ++i) {
+            a.get_sq_entry().prep_nop().set_data(i);
+        }
+        a.get_sq_entry().prep_nop().set_data(i++).set_link();
+        a.get_sq_entry().prep_nop().set_data(i++).set_link();
+        a.get_sq_entry().prep_nop().set_data(i++).set_hard_link();
+        b.get_sq_entry().prep_nop().set_data(1ULL << 32);
+        b.publish();
+        a.get_sq_entry().prep_nop().set_data(i++);
+    }
+    data = drain_all(ring, stage, unlinked + 5);
+    expect.assign(unlinked, 0);
+    for (uint64_t i = 0; i < unlinked; ++i) {
+        expect[i] = i;
+    }
+    expect.push_back(1ULL << 32);
+    for (uint64_t i = unlinked; i < unlinked + 4; ++i) {
+        expect.push_back(i);
+    }
+    CHECK(data == expect);
+
+    // a link chain longer than a batch is rejected
+    {
+        auto p = stage.make_producer();
+        sq_entry *last = nullptr;
+        for (unsigned i = 0; i < staged_submitter<uring_flags>::batch_size;
+             ++i) {
+            last = &p.get_sq_entry().prep_nop().set_link();
+        }
+        bool rejected = false;
+        try {
+            (void)p.get_sq_entry();
+        } catch (const std::system_error &e) {
+            rejected = e.code().value() == E2BIG;
+        }
+        CHECK(rejected);
+        last->reset_flags(0);
+    }
+    data = drain_all(ring, stage, staged_submitter<uring_flags>::batch_size);
+    CHECK(!stage.has_pending());
+}
+
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 19)
+template<uint64_t uring_flags, typename Cmd>
+constexpr bool can_prep_uring_cmd =
+    requires(liburingcxx::sq_entry &sqe, const Cmd &cmd) {
+        liburingcxx::uring<uring_flags>::prep_uring_cmd(sqe, 0U, 0, cmd);
+    };
+
+/*
+ * Prepare a uring_cmd carrying `cmd` into the first sqe of `sqes`, which are
+ * filled by garbage before, and check its command area: `cmd` then zeros up
+ * to the end of the (128-byte) sqe, leaving the next sqe untouched.
+ */
+template<uint64_t uring_flags, typename Cmd>
+bool check_cmd_area(const Cmd &cmd) {
+    using namespace liburingcxx;
+    constexpr size_t area_size = uring<uring_flags>::cmd_area_size;
+    constexpr size_t area_offset = offsetof(io_uring_sqe, cmd);
+    constexpr size_t sqe_size = area_offset + area_size;
+    alignas(64) sq_entry sqes[3];
+    std::memset(static_cast<void *>(sqes), 0x5a, sizeof(sqes));
+
+    uring<uring_flags>::prep_uring_cmd(sqes[0], 42, 3, cmd);
+    const io_uring_sqe head = raw(sqes[0]);
+    const auto *const bytes = reinterpret_cast<const unsigned char *>(sqes);
+    bool ok = head.opcode == IORING_OP_URING_CMD && head.cmd_op == 42
+              && head.fd == 3 && sqes[0].get_cmd() == bytes + area_offset
+              && std::memcmp(bytes + area_offset, &cmd, sizeof(Cmd)) == 0;
+    for (size_t i = area_offset + sizeof(Cmd); i < sqe_size; ++i) {
+        ok = ok && bytes[i] == 0;
+    }
+    for (size_t i = sqe_size; i < sizeof(sqes); ++i) {
+        ok = ok && bytes[i] == 0x5a;
+    }
+    return ok;
+}
+
+void check_uring_cmd() {
+    using namespace liburingcxx;
+    constexpr uint64_t sqe128 = IORING_SETUP_SQE128;
+    static_assert(sq_entry::cmd_size == 16);
+    static_assert(sq_entry::cmd_size_sqe128 == 80);
+    static_assert(uring<0>::cmd_area_size == sq_entry::cmd_size);
+    static_assert(uring<sqe128>::cmd_area_size == sq_entry::cmd_size_sqe128);
+
+    struct small {
+        uint32_t a;
+    };
+    struct full {
+        uint64_t a[2];
+    };
+    struct big {
+        uint64_t a[10];
+    };
+    struct too_big {
+        uint64_t a[11];
+    };
+    static_assert(can_prep_uring_cmd<0, full>);
+    static_assert(!can_prep_uring_cmd<0, big>);
+    static_assert(can_prep_uring_cmd<sqe128, big>);
+    static_assert(!can_prep_uring_cmd<sqe128, too_big>);
+
+    CHECK(check_cmd_area<0>(small{0x11223344}));
+    CHECK(check_cmd_area<0>(full{{1, 2}}));
+    CHECK(check_cmd_area<sqe128>(small{0x11223344}));
+    CHECK(check_cmd_area<sqe128>(big{{1, 2, 3, 4, 5, 6, 7, 8, 9, 10}}));
+}
+#endif
+
+template<uint64_t uring_flags, typename T>
+constexpr bool can_big_cqe_as = requires(const liburingcxx::cq_entry &cqe) {
+    liburingcxx::uring<uring_flags>::template big_cqe_as<T>(cqe);
+};
+
+void check_big_cqe() {
+    using namespace liburingcxx;
+    constexpr uint64_t cqe32 = IORING_SETUP_CQE32;
+    struct result {
+        int32_t status;
+        uint16_t tag;
+        uint64_t value;
+    };
+    static_assert(sizeof(result) == 16);
+    struct full_extra {
+        uint64_t a;
+        uint64_t b;
+
+        bool operator==(const full_extra &) const = default;
+    };
+    static_assert(can_big_cqe_as<cqe32, result>);
+    static_assert(can_big_cqe_as<cqe32, uint32_t>);
+    static_assert(!can_big_cqe_as<cqe32, char[17]>);
+    static_assert(!can_big_cqe_as<0, result>);
+
+    // a 32-byte cqe, as posted on a CQE32 ring
+    alignas(io_uring_cqe) unsigned char storage[2 * sizeof(io_uring_cqe)];
+    std::memset(storage, 0x5a, sizeof(storage));
+    const result expect{-5, 0xbeef, 0x0123'4567'89ab'cdefULL};
+    std::memcpy(storage + sizeof(io_uring_cqe), &expect, sizeof(expect));
+    const auto &cqe = *reinterpret_cast<const cq_entry *>(storage);
+
+    const result got = uring<cqe32>::big_cqe_as<result>(cqe);
+    CHECK(got.status == expect.status && got.tag == expect.tag);
+    CHECK(got.value == expect.value);
+    CHECK(uring<cqe32>::big_cqe_as<uint32_t>(cqe) == uint32_t(expect.status));
+
+    uint64_t words[2];
+    std::memcpy(words, &expect, sizeof(words));
+    const auto big = uring<cqe32>::big_cqe(cqe);
+    CHECK(big[0] == words[0] && big[1] == words[1]);
+
+    // cqes of a CQE32 ring are read with a 32-byte stride
+    uring<cqe32> ring;
+    ring.init(8);
+    ring.get_sq_entry()->prep_nop().set_data(1);
+    ring.get_sq_entry()->prep_nop().set_data(2);
+    ring.submit_and_wait(2);
+    std::vector<uint64_t> data;
+    bool zero_extra = true;
+    const unsigned n = ring.for_each_cqe([&](cq_entry *c) {
+        data.push_back(c->user_data);
+        zero_extra = zero_extra && uring<cqe32>::big_cqe_as<full_extra>(*c)
+                                       == full_extra{0, 0};
+    });
+    if (n != 0) {
+        ring.cq_advance(n);
+    }
+    CHECK(data == std::vector<uint64_t>{1, 2});
+    CHECK(zero_extra);
+}
+
+void check_cq_sizing() {
+    using namespace liburingcxx;
+    constexpr unsigned max = uring_params::max_cq_entries;
+    // at least twice the SQ, rounded up to pow of 2, capped at the max
+    static_assert(uring_params::recommend_cq_entries(128, 0) == 256);
+    static_assert(uring_params::recommend_cq_entries(128, 1) == 256);
+    static_assert(uring_params::recommend_cq_entries(128, 2) == 256);
+    static_assert(uring_params::recommend_cq_entries(100, 1) == 256);
+    static_assert(uring_params::recommend_cq_entries(100, 3) == 512);
+    static_assert(uring_params::recommend_cq_entries(1, 5) == 8);
+    static_assert(uring_params::recommend_cq_entries(32768, 2) == max);
+    static_assert(uring_params::recommend_cq_entries(32768, 64) == max);
+    static_assert(uring_params::recommend_cq_entries(40000, ~0U) == max);
+
+    uring_params p{0};
+    p.set_cq_entries(100).set_clamp();
+    CHECK(p.flags == (IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP));
+    CHECK(p.cq_entries == 100);
+
+    // the kernel rounds CQ entries up to pow of 2
+    {
+        uring<0> ring;
+        ring.init(8, uring_params{0}.set_cq_entries(100));
+        CHECK(ring_fdinfo::read(ring).cq_mask == 127);
+    }
+    // and clamps them only with IORING_SETUP_CLAMP
+    {
+        uring<0> ring;
+        ring.init(8, uring_params{0}.set_cq_entries(max * 2).set_clamp());
+        CHECK(ring_fdinfo::read(ring).cq_mask == max - 1);
+    }
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 5)
+    // the app memory of IORING_SETUP_NO_MMAP is sized by the same rules
+    {
+        uring<IORING_SETUP_NO_MMAP> ring;
+        ring.init(
+            8,
+            uring_params{IORING_SETUP_NO_MMAP}
+                .set_cq_entries(max * 2)
+                .set_clamp()
+        );
+        CHECK(ring_fdinfo::read(ring).cq_mask == max - 1);
+    }
+#endif
+    bool rejected = false;
+    try {
+        uring<0> ring;
+        ring.init(8, uring_params{0}.set_cq_entries(max * 2));
+    } catch (const std::system_error &e) {
+        rejected = e.code().value() == EINVAL;
+    }
+    CHECK(rejected);
+}
+
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 17)
+// only failed fire-and-forget sqes post cqes, and they go to on_failure
+void check_fire_and_forget() {
+    using namespace liburingcxx;
+    uring<0> ring;
+    ring.init(8);
+    ring.get_sq_entry()->prep_nop().set_fire_and_forget(1);
+    // no such fd
+    ring.get_sq_entry()->prep_close(-1).set_fire_and_forget(2);
+    ring.get_sq_entry()->prep_nop().set_data(3);
+    ring.submit_and_wait(2);
+
+    std::vector<uint64_t> done;
+    std::vector<uint64_t> failed;
+    int failed_res = 0;
+    const unsigned n = ring.for_each_cqe(
+        [&](cq_entry *cqe) { done.push_back(cqe->user_data); },
+        [&](cq_entry *cqe) {
+            failed.push_back(cqe->user_data & ~fire_and_forget_flag);
+            failed_res = cqe->res;
+        }
+    );
+    CHECK(n == 2);
+    if (n != 0) {
+        ring.cq_advance(n);
+    }
+    CHECK(done == std::vector<uint64_t>{3});
+    CHECK(failed == std::vector<uint64_t>{2});
+    CHECK(failed_res == -EBADF);
+}
+#endif
+
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 0)
+// results of the cqes posted by the task work run so far
+template<uint64_t uring_flags>
+std::vector<int32_t> reap_res(liburingcxx::uring<uring_flags> &ring) {
+    ring.get_events();
+    std::vector<int32_t> res;
+    const unsigned n = ring.for_each_cqe([&](liburingcxx::cq_entry *cqe) {
+        res.push_back(cqe->res);
+    });
+    if (n != 0) {
+        ring.cq_advance(n);
+    }
+    return res;
+}
+
+template<uint64_t uring_flags>
+void check_sync_cancel() {
+    using namespace liburingcxx;
+    uring<uring_flags> ring;
+    ring.init(8);
+    int fds[2];
+    if (::pipe(fds) != 0) {
+        CHECK(false);
+        return;
+    }
+    char buf[8];
+
+    // nothing in flight
+    CHECK(ring.sync_cancel(1, 0) == -ENOENT);
+    CHECK(ring.sync_cancel_fd(fds[0]) == 0);
+    CHECK(ring.sync_cancel_all() == 0);
+
+    // reads of an empty pipe block until canceled
+    ring.get_sq_entry()->prep_read(fds[0], buf, 0).set_data(1);
+    ring.submit();
+    CHECK(ring.sync_cancel(1, 0) == 0);
+    CHECK(reap_res(ring) == std::vector<int32_t>{-ECANCELED});
+
+    ring.get_sq_entry()->prep_read(fds[0], buf, 0).set_data(2);
+    ring.submit();
+    CHECK(ring.sync_cancel_fd(fds[0]) == 0);
+    CHECK(reap_res(ring) == std::vector<int32_t>{-ECANCELED});
+
+    // the one punted to io-wq may be running when canceled
+    ring.get_sq_entry()->prep_read(fds[0], buf, 0).set_data(3);
+    ring.get_sq_entry()->prep_read(fds[0], buf, 0).set_async().set_data(4);
+    ring.submit();
+    CHECK(ring.sync_cancel_all() == 0);
+    const std::vector<int32_t> res = reap_res(ring);
+    CHECK(res.size() == 2);
+    for (const int32_t r : res) {
+        CHECK(r == -ECANCELED || r == -EINTR);
+    }
+    CHECK(ring.sync_cancel_all() == 0);
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+// a released ring comes back with nothing in flight and an empty CQ
+void check_ring_pool() {
+    using namespace liburingcxx;
+    ring_pool<0> pool{1, 8};
+    int fds[2];
+    if (::pipe(fds) != 0) {
+        CHECK(false);
+        return;
+    }
+    char buf[8];
+    {
+        auto ring = pool.acquire();
+        ring->get_sq_entry()->prep_read(fds[0], buf, 0).set_data(1);
+        ring->get_sq_entry()->prep_read(fds[0], buf, 0).set_async().set_data(2);
+        ring->get_sq_entry()->prep_nop().set_data(3);
+        ring->submit();
+    }
+    CHECK(pool.idle_num() == 1);
+    auto ring = pool.acquire();
+    CHECK(reap_res(*ring).empty());
+    // the reads would complete now if they were still in flight
+    CHECK(::write(fds[1], "ping", 4) == 4);
+    CHECK(reap_res(*ring).empty());
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+#endif
+
+void check_fdinfo() {
+    using namespace liburingcxx;
+    // shaped like 6.18, with entries in every list
+    static constexpr char text[] =
+        "pos:\t0\n"
+        "flags:\t02000002\n"
+        "SqMask:\t0x7f\n"
+        "SqHead:\t1030\n"
+        "SqTail:\t1032\n"
+        "CachedSqHead:\t1031\n"
+        "CqMask:\t0xff\n"
+        "CqHead:\t900\n"
+        "CqTail:\t1000\n"
+        "CachedCqTail:\t1001\n"
+        "SQEs:\t2\n"
+        "CQEs:\t100\n"
+        "SqThread:\t4242\n"
+        "SqThreadCpu:\t3\n"
+        "SqTotalTime:\t123456789012\n"
+        "SqWorkTime:\t42\n"
+        "UserFiles:\t2\n"
+        "    0: sock\n"
+        "    1: pipe\n"
+        "UserBufs:\t1\n"
+        "    0: 0x7f0000000000/4096\n"
+        "PollList:\n"
+        "  op=6, task_works=0\n"
+        "  op=27, task_works=1\n"
+        "CqOverflowList:\n"
+        "  user_data=18446744073709551615, res=-125, flags=2\n"
+        "  user_data=7, res=0, flags=0\n"
+        "NAPI:\tdisabled\n";
+    std::FILE *const file = ::fmemopen(
+        const_cast<char *>(text), sizeof(text) - 1, "r"
+    );
+    if (file == nullptr) {
+        CHECK(false);
+        return;
+    }
+    const ring_fdinfo info = ring_fdinfo::parse(file);
+    std::fclose(file);
+
+    CHECK(info.sq_mask == 0x7f && info.cq_mask == 0xff);
+    CHECK(info.sq_head == 1030 && info.sq_tail == 1032);
+    CHECK(info.cached_sq_head == 1031);
+    CHECK(info.cq_head == 900 && info.cq_tail == 1000);
+    CHECK(info.cached_cq_tail == 1001);
+    CHECK(info.sq_pending == 2 && info.cq_pending == 100);
+    CHECK(info.sq_thread == 4242 && info.sq_thread_cpu == 3);
+    CHECK(info.sq_total_time == 123456789012ULL && info.sq_work_time == 42);
+    // entries of UserFiles and UserBufs are not counted as list entries
+    CHECK(info.user_files == 2 && info.user_bufs == 1);
+    CHECK(info.poll_list == 2);
+    CHECK(info.cq_overflow_list.size() == 2);
+    if (info.cq_overflow_list.size() == 2) {
+        const auto &first = info.cq_overflow_list[0];
+        CHECK(first.user_data == ~0ULL);
+        CHECK(first.res == -125 && first.flags == 2);
+        const auto &second = info.cq_overflow_list[1];
+        CHECK(second.user_data == 7 && second.res == 0 && second.flags == 0);
+    }
+
+    // fields missing on older kernels keep their defaults
+    static constexpr char old_text[] =
+        "SqMask:\t0x7\n"
+        "SqThread:\t-1\n"
+        "PollList:\n";
+    std::FILE *const old_file = ::fmemopen(
+        const_cast<char *>(old_text), sizeof(old_text) - 1, "r"
+    );
+    if (old_file == nullptr) {
+        CHECK(false);
+        return;
+    }
+    const ring_fdinfo old_info = ring_fdinfo::parse(old_file);
+    std::fclose(old_file);
+    CHECK(old_info.sq_mask == 7 && old_info.sq_thread == -1);
+    CHECK(old_info.sq_thread_cpu == -1 && old_info.sq_total_time == 0);
+    CHECK(old_info.poll_list == 0 && old_info.cq_overflow_list.empty());
+
+    // and the fdinfo of a live ring
+    uring<0> ring;
+    ring.init(8);
+    const ring_fdinfo live = ring_fdinfo::read(ring);
+    CHECK(live.sq_mask == 7 && live.cq_mask == 15);
+}
+
+} // namespace
+
+int main() {
+    check_user_data_schema();
+    check_context_pool();
+    check_sq_chain();
+    check_fill_rw();
+    check_sqe_template();
+    check_fdinfo();
+    check_cq_sizing();
+    check_big_cqe();
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 19)
+    check_uring_cmd();
+#endif
+    check_staged_submitter<sim_flags>();
+    check_staged_submitter<sim_reorder_flags>();
+#if LIBURINGCXX_IS_KERNEL_REACH(5, 17)
+    check_fire_and_forget();
+#endif
+#if LIBURINGCXX_IS_KERNEL_REACH(6, 0)
+    check_sync_cancel<0>();
+    check_sync_cancel<defer_flags>();
+    check_ring_pool();
+#endif
+
+    if (failed_num != 0) {
+        std::cerr << failed_num << " checks failed.\n";
+        return 1;
+    }
+    std::cout << "All test passed!\n";
+    return 0;
+}